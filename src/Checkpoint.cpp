@@ -0,0 +1,182 @@
+#include "Checkpoint.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(sf::Color) == 4, "colors are saved as 4 bytes (RGBA)");
+
+// Saved arrays, in file order: x, y, vx, vy, radius, mass, color, enabled
+#define CHECKPOINT_ARRAYS 8
+static const size_t ARRAY_ELEM_SIZE[] = {4, 4, 4, 4, 4, 4, 4, 1};
+
+/**
+ * Static helper: rounds a file offset up to the array alignment.
+ */
+static uint64_t align_up(uint64_t offset)
+{
+  return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+/**
+ * Static helper: file offset of every array for n particles, and the minimum
+ * file size.
+ */
+static uint64_t array_offsets(uint32_t n, uint64_t *offsets)
+{
+  uint64_t offset = align_up(sizeof(checkpoint_header_t));
+  uint64_t end = offset;
+  for (size_t k = 0; k < CHECKPOINT_ARRAYS; k++)
+  {
+    offsets[k] = offset;
+    end = offset + (uint64_t)n * ARRAY_ELEM_SIZE[k];
+    offset = align_up(end);
+  }
+  return end;
+}
+
+/**
+ * Static helper: checks that a header is one this build can read.
+ */
+static bool header_is_valid(const checkpoint_header_t *header)
+{
+  return !memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) &&
+         header->version == CHECKPOINT_VERSION &&
+         header->byte_order == CHECKPOINT_BYTE_ORDER &&
+         header->n_particles > 0;
+}
+
+p_sim_error_t Checkpoint::write(const char *path, checkpoint_header_t header,
+                                const ParticleStore *store)
+{
+  if (NULL == path || NULL == store)
+    return ERR_NULL_PTR;
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version = CHECKPOINT_VERSION;
+  header.byte_order = CHECKPOINT_BYTE_ORDER;
+  header.n_particles = (uint32_t)store->size();
+  const void *arrays[CHECKPOINT_ARRAYS] = {
+      store->x.data(),      store->y.data(),      store->vx.data(),
+      store->vy.data(),     store->radius.data(), store->mass.data(),
+      store->color.data(),  store->enabled.data()};
+  uint64_t offsets[CHECKPOINT_ARRAYS];
+  array_offsets(header.n_particles, offsets);
+
+  std::string tmp_path = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp_path.c_str(), "wb");
+  if (NULL == f)
+    return ERR_IO;
+  static const char zeros[CHECKPOINT_ALIGN] = {0};
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  uint64_t written = sizeof(header);
+  for (size_t k = 0; ok && k < CHECKPOINT_ARRAYS; k++)
+  {
+    size_t pad = (size_t)(offsets[k] - written);
+    size_t bytes = (size_t)header.n_particles * ARRAY_ELEM_SIZE[k];
+    ok = fwrite(zeros, 1, pad, f) == pad &&
+         fwrite(arrays[k], 1, bytes, f) == bytes;
+    written = offsets[k] + bytes;
+  }
+  ok = (0 == fclose(f)) && ok;
+  if (!ok || 0 != rename(tmp_path.c_str(), path))
+  {
+    remove(tmp_path.c_str());
+    return ERR_IO;
+  }
+  return ERR_OK;
+}
+
+p_sim_error_t Checkpoint::read_header(const char *path,
+                                      checkpoint_header_t *header)
+{
+  if (NULL == path || NULL == header)
+    return ERR_NULL_PTR;
+  FILE *f = fopen(path, "rb");
+  if (NULL == f)
+    return ERR_IO;
+  bool ok = fread(header, sizeof(*header), 1, f) == 1;
+  fclose(f);
+  if (!ok || !header_is_valid(header))
+    return ERR_FORMAT;
+  return ERR_OK;
+}
+
+p_sim_error_t Checkpoint::read(const char *path, checkpoint_header_t *header,
+                               ParticleStore *store)
+{
+  if (NULL == path || NULL == header || NULL == store)
+    return ERR_NULL_PTR;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return ERR_IO;
+  struct stat st;
+  if (0 != fstat(fd, &st) || (size_t)st.st_size < sizeof(*header))
+  {
+    close(fd);
+    return ERR_FORMAT;
+  }
+  size_t size = (size_t)st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping stays valid
+  if (MAP_FAILED == map)
+    return ERR_IO;
+  madvise(map, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+  p_sim_error_t res = ERR_OK;
+  const char *base = (const char *)map;
+  memcpy(header, base, sizeof(*header));
+  uint64_t offsets[CHECKPOINT_ARRAYS];
+  if (!header_is_valid(header) ||
+      array_offsets(header->n_particles, offsets) > size)
+    res = ERR_FORMAT;
+  else
+  {
+    size_t n = header->n_particles;
+    const float *f[6];
+    for (size_t k = 0; k < 6; k++)
+      f[k] = (const float *)(base + offsets[k]);
+    const sf::Color *color = (const sf::Color *)(base + offsets[6]);
+    const uint8_t *enabled = (const uint8_t *)(base + offsets[7]);
+    try
+    {
+      store->x.assign(f[0], f[0] + n);
+      store->y.assign(f[1], f[1] + n);
+      store->vx.assign(f[2], f[2] + n);
+      store->vy.assign(f[3], f[3] + n);
+      store->radius.assign(f[4], f[4] + n);
+      store->mass.assign(f[5], f[5] + n);
+      store->color.assign(color, color + n);
+      store->enabled.assign(enabled, enabled + n);
+      // Per-timestep bookkeeping, as between two timesteps
+      store->t_current.assign(n, 1.0f);
+      store->edge_collision_time.assign(n, -1.0f);
+      store->version.assign(n, 0);
+    }
+    catch (...)
+    {
+      store->clear();
+      res = ERR_NO_MEMORY;
+    }
+  }
+  munmap(map, size);
+  return res;
+}
+
+p_sim_error_t Checkpoint::apply_to_config(const char *path, SimConfig *config)
+{
+  if (NULL == config)
+    return ERR_NULL_PTR;
+  checkpoint_header_t header;
+  p_sim_error_t res = read_header(path, &header);
+  if (ERR_OK != res)
+    return res;
+  config->n_particles = header.n_particles;
+  config->field_center_x = header.field_center_x;
+  config->field_center_y = header.field_center_y;
+  config->field_radius = header.field_radius;
+  return ERR_OK;
+}
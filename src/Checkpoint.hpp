@@ -0,0 +1,90 @@
+#ifndef __CHECKPOINT_HPP__
+#define __CHECKPOINT_HPP__
+
+#include "ParticleStore.hpp"
+#include "SimConfig.hpp"
+#include "p_sim_error.h"
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC "PSIMCKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+#define CHECKPOINT_ALIGN 64 // every array starts on a cache line
+
+/**
+ * @brief Fixed-size checkpoint file header (version 1).
+ */
+typedef struct
+{
+  char magic[8];       // CHECKPOINT_MAGIC, not NUL terminated
+  uint32_t version;    // CHECKPOINT_VERSION
+  uint32_t byte_order; // CHECKPOINT_BYTE_ORDER as written by the writer
+  uint64_t timestep;   // timesteps run when the checkpoint was taken
+  uint64_t rng_state;  // SimRandom state
+  uint64_t rng_inc;
+  uint32_t n_particles;
+  float field_center_x;
+  float field_center_y;
+  float field_radius;
+} checkpoint_header_t;
+
+/**
+ * @brief Binary snapshot of a sim between timesteps.
+ *
+ * The file is the header followed by the persistent particle arrays (x, y,
+ * vx, vy, radius, mass, color, enabled) in structure-of-arrays order, each
+ * padded to CHECKPOINT_ALIGN bytes, in the writer's native byte order. Per
+ * timestep bookkeeping (t_current, version, ...) is not saved; it is reset at
+ * the start of every timestep anyway.
+ *
+ * Loading maps the file and copies each array into the store in one block,
+ * so a restart costs about as much as reading the file.
+ */
+class Checkpoint
+{
+public:
+  /**
+   * @brief Writes a checkpoint. The file is written under a temporary name
+   * and renamed into place, so an existing checkpoint is never left half
+   * overwritten.
+   * @param path checkpoint file path
+   * @param header header to write (magic, version and byte order are set
+   * here)
+   * @param store particles to save
+   * @return ERR_OK if successful, ERR_IO if the file cannot be written
+   */
+  static p_sim_error_t write(const char *path, checkpoint_header_t header,
+                             const ParticleStore *store);
+
+  /**
+   * @brief Reads and validates a checkpoint's header only.
+   * @param path checkpoint file path
+   * @param header where to store the header
+   * @return ERR_OK if successful, ERR_IO if the file cannot be read,
+   * ERR_FORMAT if it is not a compatible checkpoint
+   */
+  static p_sim_error_t read_header(const char *path,
+                                   checkpoint_header_t *header);
+
+  /**
+   * @brief Loads a checkpoint into a store (replacing its particles).
+   * @param path checkpoint file path
+   * @param header where to store the header
+   * @param store particle storage to fill
+   * @return ERR_OK if successful, ERR_IO if the file cannot be read,
+   * ERR_FORMAT if it is not a compatible checkpoint
+   */
+  static p_sim_error_t read(const char *path, checkpoint_header_t *header,
+                            ParticleStore *store);
+
+  /**
+   * @brief Takes the particle count and field geometry of a checkpoint into
+   * a config, so the sim and field built from it match the checkpoint.
+   * @param path checkpoint file path
+   * @param config config to update
+   * @return as `read_header()`
+   */
+  static p_sim_error_t apply_to_config(const char *path, SimConfig *config);
+};
+
+#endif
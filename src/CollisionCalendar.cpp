@@ -0,0 +1,204 @@
+#include "CollisionCalendar.hpp"
+#include "config.h"
+
+#include <algorithm> // for std::min()
+
+#define CALENDAR_PENDING (UINT32_MAX - 1) // bucket_of: put(), not bucketed
+#define CALENDAR_SCAN_MAX 64              // scan length that re-buckets
+#define CALENDAR_REBUCKET_MIN 64          // smaller queues never re-bucket
+
+CollisionCalendar::CollisionCalendar()
+{
+  this->n_buckets = CALENDAR_BUCKETS_MIN;
+  this->head.assign(this->n_buckets, PARTICLE_NONE);
+  this->t_lo = 0.0f;
+  this->scale = (float)this->n_buckets;
+  this->count = 0;
+  this->scan_limit = CALENDAR_SCAN_MAX;
+  this->cursor = this->n_buckets;
+  this->min_p = PARTICLE_NONE;
+  this->last_scan = 0;
+}
+
+uint32_t CollisionCalendar::bucket(float time) const
+{
+  float x = (time - this->t_lo) * this->scale;
+  if (!(x > 0.0f)) // also NaN
+    return 0;
+  if (x >= (float)this->n_buckets)
+    return this->n_buckets - 1;
+  return (uint32_t)x;
+}
+
+void CollisionCalendar::link(particle_t p)
+{
+  uint32_t b = this->bucket(this->events[p].time);
+  particle_t first = this->head[b];
+  this->next[p] = first;
+  this->prev[p] = PARTICLE_NONE;
+  if (PARTICLE_NONE != first)
+    this->prev[first] = p;
+  this->head[b] = p;
+  this->bucket_of[p] = b;
+  this->count++;
+  if (b < this->cursor)
+  {
+    // Every bucket before the cursor is empty, so p is the earliest
+    this->cursor = b;
+    this->min_p = p;
+  }
+  else if (b == this->cursor && PARTICLE_NONE != this->min_p &&
+           this->events[this->min_p] > this->events[p])
+    this->min_p = p;
+}
+
+void CollisionCalendar::unlink(particle_t p)
+{
+  uint32_t b = this->bucket_of[p];
+  this->bucket_of[p] = UINT32_MAX;
+  this->count--;
+  if (p == this->min_p)
+    this->min_p = PARTICLE_NONE;
+  if (CALENDAR_PENDING == b)
+    return; // build() skips it
+  particle_t n = this->next[p];
+  particle_t pr = this->prev[p];
+  if (PARTICLE_NONE != pr)
+    this->next[pr] = n;
+  else
+    this->head[b] = n;
+  if (PARTICLE_NONE != n)
+    this->prev[n] = pr;
+}
+
+void CollisionCalendar::find_min() const
+{
+  uint32_t b = this->cursor;
+  while (PARTICLE_NONE == this->head[b])
+    b++;
+  this->cursor = b;
+  particle_t best = this->head[b];
+  uint32_t scanned = 1;
+  for (particle_t p = this->next[best]; PARTICLE_NONE != p; p = this->next[p])
+  {
+    if (this->events[best] > this->events[p])
+      best = p;
+    scanned++;
+  }
+  this->min_p = best;
+  this->last_scan = scanned;
+}
+
+void CollisionCalendar::rebucket()
+{
+  std::vector<particle_t> &members = this->members;
+  members.clear();
+  for (uint32_t b = this->cursor; b < this->n_buckets; b++)
+  {
+    for (particle_t p = this->head[b]; PARTICLE_NONE != p; p = this->next[p])
+      members.push_back(p);
+  }
+  for (particle_t p : this->pending)
+  {
+    if (CALENDAR_PENDING != this->bucket_of[p])
+      continue; // removed, or listed twice
+    members.push_back(p);
+    this->bucket_of[p] = 0;
+  }
+  this->pending.clear();
+
+  // Buckets from the earliest event to the end of the timestep
+  float t_min = 1.0f;
+  for (particle_t p : members)
+    t_min = std::min(t_min, this->events[p].time);
+  size_t wanted = members.size() / CALENDAR_BUCKET_EVENTS;
+  uint32_t n_buckets = CALENDAR_BUCKETS_MIN;
+  while (n_buckets < wanted && n_buckets < CALENDAR_BUCKETS_MAX)
+    n_buckets *= 2;
+  float span = 1.0f - t_min;
+  if (!(span > EPS))
+    span = EPS;
+  this->n_buckets = n_buckets;
+  this->head.assign(n_buckets, PARTICLE_NONE);
+  this->t_lo = t_min;
+  this->scale = (float)n_buckets / span;
+  this->count = 0;
+  this->cursor = n_buckets;
+  this->min_p = PARTICLE_NONE;
+  this->last_scan = 0;
+  for (particle_t p : members)
+    this->link(p);
+}
+
+void CollisionCalendar::check_density()
+{
+  if (this->count < CALENDAR_REBUCKET_MIN)
+    return;
+  if (this->last_scan > this->scan_limit)
+  {
+    // Events bunch up in a few buckets: narrower ones may spread them. If
+    // they do not, the limit doubles so that re-bucketing stays amortized.
+    this->scan_limit = 2 * this->last_scan;
+    this->rebucket();
+    return;
+  }
+  // Time moved past most buckets, or there are too few for the events
+  size_t ahead = this->n_buckets - this->cursor;
+  bool can_grow = this->n_buckets < CALENDAR_BUCKETS_MAX;
+  if (this->count > ahead * CALENDAR_BUCKET_EVENTS * 4 &&
+      (can_grow || 2 * ahead <= this->n_buckets))
+    this->rebucket();
+}
+
+void CollisionCalendar::reset(size_t n)
+{
+  this->events.resize(n);
+  this->bucket_of.assign(n, UINT32_MAX);
+  this->next.resize(n);
+  this->prev.resize(n);
+  this->pending.clear();
+  // The bucket count is kept from the last timestep's density
+  this->head.assign(this->n_buckets, PARTICLE_NONE);
+  this->t_lo = 0.0f;
+  this->scale = (float)this->n_buckets;
+  this->count = 0;
+  this->scan_limit = CALENDAR_SCAN_MAX;
+  this->cursor = this->n_buckets;
+  this->min_p = PARTICLE_NONE;
+  this->last_scan = 0;
+}
+
+void CollisionCalendar::update(const CollisionEvent &event)
+{
+  particle_t p = event.particle_i;
+  if (this->contains(p))
+    this->unlink(p);
+  this->events[p] = event;
+  this->link(p);
+  this->check_density();
+}
+
+void CollisionCalendar::remove(particle_t p)
+{
+  if (this->contains(p))
+    this->unlink(p);
+}
+
+void CollisionCalendar::put(const CollisionEvent &event)
+{
+  particle_t p = event.particle_i;
+  if (this->contains(p) && CALENDAR_PENDING != this->bucket_of[p])
+    this->unlink(p);
+  this->events[p] = event;
+  if (this->contains(p))
+    return;
+  this->bucket_of[p] = CALENDAR_PENDING;
+  this->pending.push_back(p);
+  this->count++;
+}
+
+void CollisionCalendar::build()
+{
+  this->rebucket();
+  this->scan_limit = CALENDAR_SCAN_MAX;
+}
@@ -0,0 +1,111 @@
+#ifndef __COLLISION_CALENDAR_HPP__
+#define __COLLISION_CALENDAR_HPP__
+
+#include "CollisionEvent.hpp"
+#include "ParticleStore.hpp"
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Calendar queue (events bucketed by time) holding (at most) one event
+ * per particle, with the same interface as CollisionHeap.
+ *
+ * Event times of a timestep fall in [0, 1], so the span from the earliest
+ * queued event to 1 is cut into equal-width buckets. Each bucket is an
+ * unsorted doubly linked list threaded through per-particle arrays, so
+ * inserting, moving and removing a particle's event are O(1), and finding
+ * the earliest event scans only the first non-empty bucket (the earliest
+ * event is cached until it is removed or beaten).
+ *
+ * The bucket count is sized from the observed event density, for about
+ * CALENDAR_BUCKET_EVENTS events per bucket: when the queue is built, and
+ * again (re-bucketing from the earliest event) once the buckets left ahead
+ * get crowded or a scan for the earliest event gets long. Events before the
+ * first bucket go in it, so ordering stays exact whatever the times.
+ *
+ * Events closer than EPS are ordered by particle within a bucket (like the
+ * heap), but by bucket across a bucket boundary.
+ */
+class CollisionCalendar
+{
+private:
+  std::vector<CollisionEvent> events; // event slot of each particle
+  std::vector<uint32_t> bucket_of;    // bucket of each particle's slot
+  std::vector<particle_t> next;       // bucket list links, per particle
+  std::vector<particle_t> prev;
+  std::vector<particle_t> head;       // first particle of each bucket
+  std::vector<particle_t> pending;    // put() but not yet bucketed
+  std::vector<particle_t> members;    // scratch of rebucket()
+  uint32_t n_buckets;
+  float t_lo;  // start time of the first bucket
+  float scale; // buckets per unit of time
+  size_t count;
+  uint32_t scan_limit; // re-bucket once a scan gets longer than this
+  mutable uint32_t cursor;    // every bucket before it is empty
+  mutable particle_t min_p;   // particle of the earliest event, if known
+  mutable uint32_t last_scan; // length of the last scan for the earliest
+
+  uint32_t bucket(float time) const;
+  void link(particle_t p);
+  void unlink(particle_t p);
+  void find_min() const;
+  void rebucket();
+  void check_density();
+
+public:
+  CollisionCalendar();
+
+  /**
+   * @brief Empties the queue and sizes it for n particles.
+   * @param n number of particles (valid handles are 0 .. n-1)
+   */
+  void reset(size_t n);
+
+  bool empty() const { return 0 == this->count; }
+  size_t size() const { return this->count; }
+
+  /** @brief Whether particle p currently has a scheduled event. */
+  bool contains(particle_t p) const
+  {
+    return p < this->bucket_of.size() && this->bucket_of[p] != UINT32_MAX;
+  }
+
+  /** @brief Scheduled event of particle p (only valid if contains(p)). */
+  const CollisionEvent &get(particle_t p) const { return this->events[p]; }
+
+  /** @brief Earliest scheduled event. */
+  const CollisionEvent &top() const
+  {
+    if (PARTICLE_NONE == this->min_p)
+      this->find_min();
+    return this->events[this->min_p];
+  }
+
+  /**
+   * @brief Sets the event of `event.particle_i`, inserting it or moving it
+   * to the bucket of its new time.
+   * @param event event to schedule, owned by `event.particle_i`
+   */
+  void update(const CollisionEvent &event);
+
+  /**
+   * @brief Removes the scheduled event of particle p (if any).
+   * @param p particle handle
+   */
+  void remove(particle_t p);
+
+  /** @brief Removes the earliest scheduled event. */
+  void pop() { this->remove(this->top().particle_i); }
+
+  /**
+   * @brief Sets the event of `event.particle_i` without bucketing it, for
+   * filling the queue in bulk. Call `build()` before using the queue again.
+   * @param event event to schedule, owned by `event.particle_i`
+   */
+  void put(const CollisionEvent &event);
+
+  /** @brief Sizes the buckets for the queued events and buckets them. */
+  void build();
+};
+
+#endif
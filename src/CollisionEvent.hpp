@@ -1,10 +1,10 @@
 #ifndef __COLLISION_EVENT_HPP__
 #define __COLLISION_EVENT_HPP__
 
-#include "Particle.hpp"
-#include <SFML/System/Vector2.hpp>
+#include "ParticleStore.hpp"
+#include "config.h"
+#include <stdint.h>
 
-const float EPS = 1e-9;
 const float INF = 1e30; // may need this for particle <-> particle calculations
 
 using namespace std;
@@ -25,29 +25,45 @@ enum CollisionType
  *
  * To be stored in CollisionQueue type. Items will be popped from CollisionQueue
  * in order of time, and the particle's version will increment as collisions are
- * calculated. If the versions of the referenced particles exceed the version
- * recorded at collision time, the collision is discarded.
- *
- * Note: should this be a class, at this point? Does it complicate
- * priority_queue use?
+ * calculated. If the versions of the referenced particles differ from the
+ * versions recorded at detection time, the collision is discarded.
  *
+ * Packed into 16 bytes, so that the queue's heap moves events by value:
+ * - an edge event is one whose `particle_j` is PARTICLE_NONE (the type tag);
+ * its velocity change is computed by the field when the event is applied,
+ * from the particle's state then (unchanged since detection if the event is
+ * still valid);
+ * - versions are kept as their low 16 bits (`version_tag()`). They restart at
+ * 0 every timestep, so a stale event could only pass for a valid one after
+ * its particle collided a multiple of 65536 times within one timestep.
  */
 struct CollisionEvent
 {
-  float time;              // registered time of collision (0.0 <= time <= 1.0)
-  enum CollisionType type; // type (EDGE / PARTICLE)
-  sf::Vector2f v_delta;    // (EDGE only) applied velocity delta on collision
-  Particle *particle_i;    // particle i pointer
-  Particle *particle_j;    // (PARTICLE only) particle j pointer
-  int version_i;           // version of particle i at collision time
-  int version_j; // (PARTICLE only) version of particle j at collision time
+  float time;            // registered time of collision (0.0 <= time <= 1.0)
+  particle_t particle_i; // particle i handle
+  particle_t particle_j; // particle j handle, PARTICLE_NONE for EDGE
+  uint16_t version_i;    // version tag of particle i at collision time
+  uint16_t version_j;    // (PARTICLE only) version tag of particle j
+
+  /** @brief Type (EDGE / PARTICLE). */
+  enum CollisionType type() const
+  {
+    return particle_j == PARTICLE_NONE ? CollisionType::EDGE
+                                       : CollisionType::PARTICLE;
+  }
+
+  /** @brief Version tag recorded for a particle version. */
+  static uint16_t version_tag(int32_t version) { return (uint16_t)version; }
 
   /** @brief '>' operator override, to order Collisions by time. */
   bool operator>(const CollisionEvent &o) const
   {
     if (std::abs(time - o.time) > EPS)
       return time > o.time;
-    return particle_i->id > o.particle_i->id; // stable tie-break
+    // Stable tie-break, independent of the order events were detected in
+    if (particle_i != o.particle_i)
+      return particle_i > o.particle_i;
+    return particle_j > o.particle_j;
   };
 
   /** @brief '<' operator override for priority_queue (min-heap by time). */
@@ -55,8 +71,12 @@ struct CollisionEvent
   {
     if (std::abs(time - o.time) > EPS)
       return time > o.time; // Inverted: larger time = lower priority
-    return particle_i->id > o.particle_i->id;
+    if (particle_i != o.particle_i)
+      return particle_i > o.particle_i;
+    return particle_j > o.particle_j;
   };
 };
 
+static_assert(sizeof(CollisionEvent) == 16, "CollisionEvent is packed");
+
 #endif
@@ -0,0 +1,101 @@
+#include "CollisionHeap.hpp"
+
+void CollisionHeap::place(uint32_t idx, const CollisionEvent &event)
+{
+  this->heap[idx] = event;
+  this->heap_pos[event.particle_i] = idx;
+}
+
+void CollisionHeap::sift_up(uint32_t idx)
+{
+  CollisionEvent event = this->heap[idx];
+  while (idx > 0)
+  {
+    uint32_t parent = (idx - 1) / 2;
+    if (!(this->heap[parent] > event))
+      break;
+    this->place(idx, this->heap[parent]);
+    idx = parent;
+  }
+  this->place(idx, event);
+}
+
+void CollisionHeap::sift_down(uint32_t idx)
+{
+  CollisionEvent event = this->heap[idx];
+  uint32_t n = (uint32_t)this->heap.size();
+  while (true)
+  {
+    uint32_t child = 2 * idx + 1;
+    if (child >= n)
+      break;
+    if (child + 1 < n && this->heap[child] > this->heap[child + 1])
+      child++;
+    if (!(event > this->heap[child]))
+      break;
+    this->place(idx, this->heap[child]);
+    idx = child;
+  }
+  this->place(idx, event);
+}
+
+void CollisionHeap::reset(size_t n)
+{
+  this->heap.clear();
+  this->heap.reserve(n);
+  this->heap_pos.assign(n, UINT32_MAX);
+}
+
+void CollisionHeap::update(const CollisionEvent &event)
+{
+  particle_t p = event.particle_i;
+  if (this->contains(p))
+  {
+    uint32_t idx = this->heap_pos[p];
+    bool earlier = this->heap[idx] > event;
+    this->heap[idx] = event;
+    if (earlier)
+      this->sift_up(idx);
+    else
+      this->sift_down(idx);
+    return;
+  }
+  this->heap.push_back(event);
+  this->heap_pos[p] = (uint32_t)(this->heap.size() - 1);
+  this->sift_up(this->heap_pos[p]);
+}
+
+void CollisionHeap::remove(particle_t p)
+{
+  if (!this->contains(p))
+    return;
+  uint32_t idx = this->heap_pos[p];
+  CollisionEvent last = this->heap.back();
+  this->heap.pop_back();
+  this->heap_pos[p] = UINT32_MAX;
+  if (last.particle_i == p)
+    return;
+  this->place(idx, last);
+  // The moved entry may belong above or below its new position
+  this->sift_up(idx);
+  this->sift_down(this->heap_pos[last.particle_i]);
+}
+
+void CollisionHeap::put(const CollisionEvent &event)
+{
+  particle_t p = event.particle_i;
+  if (this->contains(p))
+  {
+    this->heap[this->heap_pos[p]] = event;
+    return;
+  }
+  this->heap.push_back(event);
+  this->heap_pos[p] = (uint32_t)(this->heap.size() - 1);
+}
+
+void CollisionHeap::build()
+{
+  // Floyd: sift every parent down, bottom-up
+  for (uint32_t idx = (uint32_t)(this->heap.size() / 2); idx-- > 0;)
+    this->sift_down(idx);
+}
@@ -0,0 +1,84 @@
+#ifndef __COLLISION_HEAP_HPP__
+#define __COLLISION_HEAP_HPP__
+
+#include "CollisionEvent.hpp"
+#include "ParticleStore.hpp"
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Indexed binary min-heap holding (at most) one event per particle.
+ *
+ * Each particle owns a slot containing its earliest predicted event, with
+ * `particle_i` set to the owning particle. Slots are ordered by event time
+ * (ties broken by particle), and can be replaced or removed in place, so the
+ * heap never holds more than one entry per particle.
+ *
+ * The heap holds the (16 byte) events themselves rather than handles to
+ * them, so ordering the heap only reads the heap array; `heap_pos` is only
+ * written as entries move.
+ */
+class CollisionHeap
+{
+private:
+  std::vector<CollisionEvent> heap; // heap of the particles' event slots
+  std::vector<uint32_t> heap_pos;   // heap index of each particle's slot
+
+  void place(uint32_t idx, const CollisionEvent &event);
+  void sift_up(uint32_t idx);
+  void sift_down(uint32_t idx);
+
+public:
+  /**
+   * @brief Empties the queue and sizes it for n particles.
+   * @param n number of particles (valid handles are 0 .. n-1)
+   */
+  void reset(size_t n);
+
+  bool empty() const { return this->heap.empty(); }
+  size_t size() const { return this->heap.size(); }
+
+  /** @brief Whether particle p currently has a scheduled event. */
+  bool contains(particle_t p) const
+  {
+    return p < this->heap_pos.size() && this->heap_pos[p] != UINT32_MAX;
+  }
+
+  /** @brief Scheduled event of particle p (only valid if contains(p)). */
+  const CollisionEvent &get(particle_t p) const
+  {
+    return this->heap[this->heap_pos[p]];
+  }
+
+  /** @brief Earliest scheduled event. */
+  const CollisionEvent &top() const { return this->heap[0]; }
+
+  /**
+   * @brief Sets the event of `event.particle_i`, inserting it or moving it
+   * up/down the heap in place (decrease/increase key).
+   * @param event event to schedule, owned by `event.particle_i`
+   */
+  void update(const CollisionEvent &event);
+
+  /**
+   * @brief Removes the scheduled event of particle p (if any).
+   * @param p particle handle
+   */
+  void remove(particle_t p);
+
+  /** @brief Removes the earliest scheduled event. */
+  void pop() { this->remove(this->heap[0].particle_i); }
+
+  /**
+   * @brief Sets the event of `event.particle_i` without restoring the heap
+   * order, for filling the queue in bulk. Call `build()` before using the
+   * queue as a heap again.
+   * @param event event to schedule, owned by `event.particle_i`
+   */
+  void put(const CollisionEvent &event);
+
+  /** @brief Restores the heap order after `put()`s, in linear time. */
+  void build();
+};
+
+#endif
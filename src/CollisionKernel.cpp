@@ -0,0 +1,471 @@
+#include "CollisionKernel.hpp"
+#include "config.h"
+
+#include <cmath>
+
+#if COLLISION_KERNEL_SIMD && (defined(__x86_64__) || defined(__i386__)) &&   \
+    (defined(__GNUC__) || defined(__clang__))
+  #define COLLISION_KERNEL_X86 1
+  // GCC 12 reports its own _mm512_undefined_ps() in <immintrin.h> as
+  // maybe-uninitialized once inlined
+  #if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+  #endif
+  #include <immintrin.h>
+#else
+  #define COLLISION_KERNEL_X86 0
+#endif
+
+// Below this, the pair has no relative motion (never will overlap)
+#define KERNEL_A_MIN 1e-9f
+
+collision_status_t CollisionKernel::time_of(const ParticleStore *ps,
+                                            particle_t p_i, particle_t p_j,
+                                            float t_now, float *t_coll)
+{
+  return time_of(ps, PerParticleRadius(), p_i, p_j, t_now, t_coll);
+}
+
+template <typename Radius>
+collision_status_t
+CollisionKernel::time_of(const ParticleStore *ps, const Radius &radius,
+                         particle_t p_i, particle_t p_j, float t_now,
+                         float *t_coll)
+{
+  if (NULL == t_coll)
+    return COLLISION_ERR;
+  *t_coll = 0.0f; // default collision value (already touching)
+  // Particles are advanced lazily, so bring both to the later of their times
+  float t_base = ps->t_current[p_i] > ps->t_current[p_j] ? ps->t_current[p_i]
+                                                         : ps->t_current[p_j];
+  sf::Vector2f dp = ps->position_at(p_i, t_base) - ps->position_at(p_j, t_base);
+  sf::Vector2f dv = ps->get_velocity(p_i) - ps->get_velocity(p_j);
+  float R_sq = radius.contact_sq(ps, p_i, p_j);
+  float A = (dv.x * dv.x) + (dv.y * dv.y);          // dv * dv
+  float B = ((dp.x * dv.x) + (dp.y * dv.y)) * 2.0f; // dp * dv
+  float C = ((dp.x * dp.x) + (dp.y * dp.y)) - R_sq; // position differential
+  if (C <= 0.0f) // overlapping: collide now, unless already separating
+    return (B < 0.0f) ? COLLISION_TRUE : COLLISION_FALSE;
+  if (A < KERNEL_A_MIN)
+    return COLLISION_FALSE;           // no relative motion
+  float D = (B * B) - (4.0f * A * C); // discriminant
+  if (D < 0.0f)
+    return COLLISION_FALSE;    // no solution
+  float sqrt_D = std::sqrt(D); // disc. sqrt
+  float t1 = (-B - sqrt_D) / (2.0f * A);
+  float t2 = (-B + sqrt_D) / (2.0f * A);
+  float t_delta;
+  if (t1 >= 0.0f)
+  {
+    t_delta = t1;
+    if (t2 >= 0.0f && t2 < t1)
+      t_delta = t2;
+  }
+  else if (t2 >= 0.0f)
+  {
+    t_delta = t2;
+  }
+  else
+  {
+    return COLLISION_FALSE;
+  }
+  if (t_delta + t_now > 1.0f)
+    return COLLISION_FALSE;
+  *t_coll = t_delta;
+  return COLLISION_TRUE;
+}
+
+/**
+ * Static helper: scalar batch, also used for the tail of the SIMD batches.
+ */
+template <typename Radius>
+static size_t batch_scalar(const ParticleStore *ps, const Radius &radius,
+                           particle_t p, const uint32_t *candidates, size_t n,
+                           float t_now, uint32_t *hit_particles,
+                           float *hit_times)
+{
+  size_t n_hits = 0;
+  for (size_t k = 0; k < n; k++)
+  {
+    float t_coll;
+    if (COLLISION_TRUE ==
+        CollisionKernel::time_of(ps, radius, p, candidates[k], t_now,
+                                 &t_coll))
+    {
+      hit_particles[n_hits] = candidates[k];
+      hit_times[n_hits] = t_coll;
+      n_hits++;
+    }
+  }
+  return n_hits;
+}
+
+#if COLLISION_KERNEL_X86
+/*
+ * The SIMD batches below mirror `CollisionKernel::time_of()` lane by lane:
+ * same operands, same operation order, and comparisons chosen to treat NaN the
+ * way the scalar branches do (e.g. !(A < min) rather than A >= min). With a
+ * uniform radius, the squared contact distance is broadcast once.
+ */
+
+template <typename Radius>
+__attribute__((target("sse2"))) static size_t
+batch_sse2(const ParticleStore *ps, const Radius &radius, particle_t p,
+         const uint32_t *candidates, size_t n, float t_now,
+         uint32_t *hit_particles, float *hit_times)
+{
+  const float *x = ps->x.data(), *y = ps->y.data();
+  const float *vx = ps->vx.data(), *vy = ps->vy.data();
+  const float *r = ps->radius.data(), *tc = ps->t_current.data();
+  const __m128 xp = _mm_set1_ps(x[p]), yp = _mm_set1_ps(y[p]);
+  const __m128 vxp = _mm_set1_ps(vx[p]), vyp = _mm_set1_ps(vy[p]);
+  const __m128 rp = _mm_set1_ps(r[p]), tcp = _mm_set1_ps(tc[p]);
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f), four = _mm_set1_ps(4.0f);
+  const __m128 a_min = _mm_set1_ps(KERNEL_A_MIN), tn = _mm_set1_ps(t_now);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 contact_sq = _mm_set1_ps(radius.contact_sq(ps, p, p));
+  size_t n_hits = 0;
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4)
+  {
+    const uint32_t *c = candidates + k;
+    __m128 xo = _mm_setr_ps(x[c[0]], x[c[1]], x[c[2]], x[c[3]]);
+    __m128 yo = _mm_setr_ps(y[c[0]], y[c[1]], y[c[2]], y[c[3]]);
+    __m128 vxo = _mm_setr_ps(vx[c[0]], vx[c[1]], vx[c[2]], vx[c[3]]);
+    __m128 vyo = _mm_setr_ps(vy[c[0]], vy[c[1]], vy[c[2]], vy[c[3]]);
+    __m128 tco = _mm_setr_ps(tc[c[0]], tc[c[1]], tc[c[2]], tc[c[3]]);
+
+    // max_ps picks tco unless tcp > tco, as the scalar ternary does
+    __m128 t_base = _mm_max_ps(tcp, tco);
+    __m128 dt_p = _mm_sub_ps(t_base, tcp), dt_o = _mm_sub_ps(t_base, tco);
+    __m128 dpx = _mm_sub_ps(_mm_add_ps(xp, _mm_mul_ps(vxp, dt_p)),
+                            _mm_add_ps(xo, _mm_mul_ps(vxo, dt_o)));
+    __m128 dpy = _mm_sub_ps(_mm_add_ps(yp, _mm_mul_ps(vyp, dt_p)),
+                            _mm_add_ps(yo, _mm_mul_ps(vyo, dt_o)));
+    __m128 dvx = _mm_sub_ps(vxp, vxo);
+    __m128 dvy = _mm_sub_ps(vyp, vyo);
+    __m128 R_sq = contact_sq;
+    if constexpr (!Radius::UNIFORM)
+    {
+      __m128 ro = _mm_setr_ps(r[c[0]], r[c[1]], r[c[2]], r[c[3]]);
+      __m128 R = _mm_add_ps(rp, ro);
+      R_sq = _mm_mul_ps(R, R);
+    }
+    __m128 A = _mm_add_ps(_mm_mul_ps(dvx, dvx), _mm_mul_ps(dvy, dvy));
+    __m128 B = _mm_mul_ps(
+        _mm_add_ps(_mm_mul_ps(dpx, dvx), _mm_mul_ps(dpy, dvy)), two);
+    __m128 C = _mm_sub_ps(
+        _mm_add_ps(_mm_mul_ps(dpx, dpx), _mm_mul_ps(dpy, dpy)), R_sq);
+    __m128 D =
+        _mm_sub_ps(_mm_mul_ps(B, B), _mm_mul_ps(_mm_mul_ps(four, A), C));
+    __m128 sqrt_D = _mm_sqrt_ps(D);
+    __m128 neg_B = _mm_xor_ps(B, sign);
+    __m128 two_A = _mm_mul_ps(two, A);
+    __m128 t1 = _mm_div_ps(_mm_sub_ps(neg_B, sqrt_D), two_A);
+    __m128 t2 = _mm_div_ps(_mm_add_ps(neg_B, sqrt_D), two_A);
+
+    __m128 overlap = _mm_cmple_ps(C, zero);
+    __m128 hit_now = _mm_and_ps(overlap, _mm_cmplt_ps(B, zero));
+    __m128 t1_ok = _mm_cmpge_ps(t1, zero);
+    __m128 t2_ok = _mm_cmpge_ps(t2, zero);
+    __m128 use_t2 = _mm_or_ps(
+        _mm_and_ps(t1_ok, _mm_and_ps(t2_ok, _mm_cmplt_ps(t2, t1))),
+        _mm_andnot_ps(t1_ok, t2_ok));
+    __m128 t = _mm_or_ps(_mm_and_ps(use_t2, t2), _mm_andnot_ps(use_t2, t1));
+    __m128 hit_later = _mm_andnot_ps(overlap, _mm_cmpnlt_ps(A, a_min));
+    hit_later = _mm_and_ps(hit_later, _mm_cmpnlt_ps(D, zero));
+    hit_later = _mm_and_ps(hit_later, _mm_or_ps(t1_ok, t2_ok));
+    hit_later = _mm_and_ps(hit_later, _mm_cmpngt_ps(_mm_add_ps(t, tn), one));
+    __m128 t_coll = _mm_andnot_ps(overlap, t); // 0 when hit on overlap
+
+    int mask = _mm_movemask_ps(_mm_or_ps(hit_now, hit_later));
+    if (mask)
+    {
+      alignas(16) float lanes[4];
+      _mm_store_ps(lanes, t_coll);
+      for (; mask; mask &= mask - 1)
+      {
+        int lane = __builtin_ctz(mask);
+        hit_particles[n_hits] = c[lane];
+        hit_times[n_hits] = lanes[lane];
+        n_hits++;
+      }
+    }
+  }
+  return n_hits + batch_scalar(ps, radius, p, candidates + k, n - k, t_now,
+                               hit_particles + n_hits, hit_times + n_hits);
+}
+
+template <typename Radius>
+__attribute__((target("avx2"))) static size_t
+batch_avx2(const ParticleStore *ps, const Radius &radius, particle_t p,
+           const uint32_t *candidates, size_t n, float t_now,
+           uint32_t *hit_particles, float *hit_times)
+{
+  const float *x = ps->x.data(), *y = ps->y.data();
+  const float *vx = ps->vx.data(), *vy = ps->vy.data();
+  const float *r = ps->radius.data(), *tc = ps->t_current.data();
+  const __m256 xp = _mm256_set1_ps(x[p]), yp = _mm256_set1_ps(y[p]);
+  const __m256 vxp = _mm256_set1_ps(vx[p]), vyp = _mm256_set1_ps(vy[p]);
+  const __m256 rp = _mm256_set1_ps(r[p]), tcp = _mm256_set1_ps(tc[p]);
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f), four = _mm256_set1_ps(4.0f);
+  const __m256 a_min = _mm256_set1_ps(KERNEL_A_MIN);
+  const __m256 tn = _mm256_set1_ps(t_now), sign = _mm256_set1_ps(-0.0f);
+  const __m256 contact_sq = _mm256_set1_ps(radius.contact_sq(ps, p, p));
+  size_t n_hits = 0;
+  size_t k = 0;
+  for (; k + 8 <= n; k += 8)
+  {
+    __m256i idx = _mm256_loadu_si256((const __m256i *)(candidates + k));
+    __m256 xo = _mm256_i32gather_ps(x, idx, 4);
+    __m256 yo = _mm256_i32gather_ps(y, idx, 4);
+    __m256 vxo = _mm256_i32gather_ps(vx, idx, 4);
+    __m256 vyo = _mm256_i32gather_ps(vy, idx, 4);
+    __m256 tco = _mm256_i32gather_ps(tc, idx, 4);
+
+    // max_ps picks tco unless tcp > tco, as the scalar ternary does
+    __m256 t_base = _mm256_max_ps(tcp, tco);
+    __m256 dt_p = _mm256_sub_ps(t_base, tcp), dt_o = _mm256_sub_ps(t_base, tco);
+    __m256 dpx = _mm256_sub_ps(_mm256_add_ps(xp, _mm256_mul_ps(vxp, dt_p)),
+                               _mm256_add_ps(xo, _mm256_mul_ps(vxo, dt_o)));
+    __m256 dpy = _mm256_sub_ps(_mm256_add_ps(yp, _mm256_mul_ps(vyp, dt_p)),
+                               _mm256_add_ps(yo, _mm256_mul_ps(vyo, dt_o)));
+    __m256 dvx = _mm256_sub_ps(vxp, vxo);
+    __m256 dvy = _mm256_sub_ps(vyp, vyo);
+    __m256 R_sq = contact_sq;
+    if constexpr (!Radius::UNIFORM)
+    {
+      __m256 R = _mm256_add_ps(rp, _mm256_i32gather_ps(r, idx, 4));
+      R_sq = _mm256_mul_ps(R, R);
+    }
+    __m256 A = _mm256_add_ps(_mm256_mul_ps(dvx, dvx), _mm256_mul_ps(dvy, dvy));
+    __m256 B = _mm256_mul_ps(
+        _mm256_add_ps(_mm256_mul_ps(dpx, dvx), _mm256_mul_ps(dpy, dvy)), two);
+    __m256 C = _mm256_sub_ps(
+        _mm256_add_ps(_mm256_mul_ps(dpx, dpx), _mm256_mul_ps(dpy, dpy)), R_sq);
+    __m256 D = _mm256_sub_ps(_mm256_mul_ps(B, B),
+                             _mm256_mul_ps(_mm256_mul_ps(four, A), C));
+    __m256 sqrt_D = _mm256_sqrt_ps(D);
+    __m256 neg_B = _mm256_xor_ps(B, sign);
+    __m256 two_A = _mm256_mul_ps(two, A);
+    __m256 t1 = _mm256_div_ps(_mm256_sub_ps(neg_B, sqrt_D), two_A);
+    __m256 t2 = _mm256_div_ps(_mm256_add_ps(neg_B, sqrt_D), two_A);
+
+    __m256 overlap = _mm256_cmp_ps(C, zero, _CMP_LE_OQ);
+    __m256 hit_now =
+        _mm256_and_ps(overlap, _mm256_cmp_ps(B, zero, _CMP_LT_OQ));
+    __m256 t1_ok = _mm256_cmp_ps(t1, zero, _CMP_GE_OQ);
+    __m256 t2_ok = _mm256_cmp_ps(t2, zero, _CMP_GE_OQ);
+    __m256 t2_first = _mm256_and_ps(t2_ok, _mm256_cmp_ps(t2, t1, _CMP_LT_OQ));
+    __m256 use_t2 = _mm256_or_ps(_mm256_and_ps(t1_ok, t2_first),
+                                 _mm256_andnot_ps(t1_ok, t2_ok));
+    __m256 t = _mm256_blendv_ps(t1, t2, use_t2);
+    __m256 hit_later =
+        _mm256_andnot_ps(overlap, _mm256_cmp_ps(A, a_min, _CMP_NLT_UQ));
+    hit_later = _mm256_and_ps(hit_later, _mm256_cmp_ps(D, zero, _CMP_NLT_UQ));
+    hit_later = _mm256_and_ps(hit_later, _mm256_or_ps(t1_ok, t2_ok));
+    hit_later = _mm256_and_ps(
+        hit_later, _mm256_cmp_ps(_mm256_add_ps(t, tn), one, _CMP_NGT_UQ));
+    __m256 t_coll = _mm256_andnot_ps(overlap, t); // 0 when hit on overlap
+
+    int mask = _mm256_movemask_ps(_mm256_or_ps(hit_now, hit_later));
+    if (mask)
+    {
+      alignas(32) float lanes[8];
+      _mm256_store_ps(lanes, t_coll);
+      for (; mask; mask &= mask - 1)
+      {
+        int lane = __builtin_ctz(mask);
+        hit_particles[n_hits] = candidates[k + lane];
+        hit_times[n_hits] = lanes[lane];
+        n_hits++;
+      }
+    }
+  }
+  return n_hits + batch_scalar(ps, radius, p, candidates + k, n - k, t_now,
+                               hit_particles + n_hits, hit_times + n_hits);
+}
+
+template <typename Radius>
+__attribute__((target("avx512f"))) static size_t
+batch_avx512(const ParticleStore *ps, const Radius &radius, particle_t p,
+             const uint32_t *candidates, size_t n, float t_now,
+             uint32_t *hit_particles, float *hit_times)
+{
+  const float *x = ps->x.data(), *y = ps->y.data();
+  const float *vx = ps->vx.data(), *vy = ps->vy.data();
+  const float *r = ps->radius.data(), *tc = ps->t_current.data();
+  const __m512 xp = _mm512_set1_ps(x[p]), yp = _mm512_set1_ps(y[p]);
+  const __m512 vxp = _mm512_set1_ps(vx[p]), vyp = _mm512_set1_ps(vy[p]);
+  const __m512 rp = _mm512_set1_ps(r[p]), tcp = _mm512_set1_ps(tc[p]);
+  const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.0f);
+  const __m512 two = _mm512_set1_ps(2.0f), four = _mm512_set1_ps(4.0f);
+  const __m512 a_min = _mm512_set1_ps(KERNEL_A_MIN);
+  const __m512 tn = _mm512_set1_ps(t_now);
+  const __m512i sign = _mm512_set1_epi32((int32_t)0x80000000);
+  const __m512 contact_sq = _mm512_set1_ps(radius.contact_sq(ps, p, p));
+  size_t n_hits = 0;
+  size_t k = 0;
+  for (; k + 16 <= n; k += 16)
+  {
+    __m512i idx = _mm512_loadu_si512((const void *)(candidates + k));
+    __m512 xo = _mm512_i32gather_ps(idx, x, 4);
+    __m512 yo = _mm512_i32gather_ps(idx, y, 4);
+    __m512 vxo = _mm512_i32gather_ps(idx, vx, 4);
+    __m512 vyo = _mm512_i32gather_ps(idx, vy, 4);
+    __m512 tco = _mm512_i32gather_ps(idx, tc, 4);
+
+    __m512 t_base = _mm512_max_ps(tcp, tco);
+    __m512 dt_p = _mm512_sub_ps(t_base, tcp), dt_o = _mm512_sub_ps(t_base, tco);
+    __m512 dpx = _mm512_sub_ps(_mm512_add_ps(xp, _mm512_mul_ps(vxp, dt_p)),
+                               _mm512_add_ps(xo, _mm512_mul_ps(vxo, dt_o)));
+    __m512 dpy = _mm512_sub_ps(_mm512_add_ps(yp, _mm512_mul_ps(vyp, dt_p)),
+                               _mm512_add_ps(yo, _mm512_mul_ps(vyo, dt_o)));
+    __m512 dvx = _mm512_sub_ps(vxp, vxo);
+    __m512 dvy = _mm512_sub_ps(vyp, vyo);
+    __m512 R_sq = contact_sq;
+    if constexpr (!Radius::UNIFORM)
+    {
+      __m512 R = _mm512_add_ps(rp, _mm512_i32gather_ps(idx, r, 4));
+      R_sq = _mm512_mul_ps(R, R);
+    }
+    __m512 A = _mm512_add_ps(_mm512_mul_ps(dvx, dvx), _mm512_mul_ps(dvy, dvy));
+    __m512 B = _mm512_mul_ps(
+        _mm512_add_ps(_mm512_mul_ps(dpx, dvx), _mm512_mul_ps(dpy, dvy)), two);
+    __m512 C = _mm512_sub_ps(
+        _mm512_add_ps(_mm512_mul_ps(dpx, dpx), _mm512_mul_ps(dpy, dpy)), R_sq);
+    __m512 D = _mm512_sub_ps(_mm512_mul_ps(B, B),
+                             _mm512_mul_ps(_mm512_mul_ps(four, A), C));
+    __m512 sqrt_D = _mm512_sqrt_ps(D);
+    __m512 neg_B = _mm512_castsi512_ps(
+        _mm512_xor_si512(_mm512_castps_si512(B), sign));
+    __m512 two_A = _mm512_mul_ps(two, A);
+    __m512 t1 = _mm512_div_ps(_mm512_sub_ps(neg_B, sqrt_D), two_A);
+    __m512 t2 = _mm512_div_ps(_mm512_add_ps(neg_B, sqrt_D), two_A);
+
+    __mmask16 overlap = _mm512_cmp_ps_mask(C, zero, _CMP_LE_OQ);
+    __mmask16 hit_now = overlap & _mm512_cmp_ps_mask(B, zero, _CMP_LT_OQ);
+    __mmask16 t1_ok = _mm512_cmp_ps_mask(t1, zero, _CMP_GE_OQ);
+    __mmask16 t2_ok = _mm512_cmp_ps_mask(t2, zero, _CMP_GE_OQ);
+    __mmask16 use_t2 =
+        (t1_ok & t2_ok & _mm512_cmp_ps_mask(t2, t1, _CMP_LT_OQ)) |
+        (~t1_ok & t2_ok);
+    __m512 t = _mm512_mask_blend_ps(use_t2, t1, t2);
+    __mmask16 hit_later = ~overlap & _mm512_cmp_ps_mask(A, a_min, _CMP_NLT_UQ) &
+                          _mm512_cmp_ps_mask(D, zero, _CMP_NLT_UQ) &
+                          (t1_ok | t2_ok) &
+                          _mm512_cmp_ps_mask(_mm512_add_ps(t, tn), one,
+                                             _CMP_NGT_UQ);
+    __m512 t_coll = _mm512_mask_blend_ps(overlap, t, zero);
+
+    __mmask16 hits = hit_now | hit_later;
+    if (hits)
+    {
+      _mm512_mask_compressstoreu_epi32(hit_particles + n_hits, hits, idx);
+      _mm512_mask_compressstoreu_ps(hit_times + n_hits, hits, t_coll);
+      n_hits += __builtin_popcount(hits);
+    }
+  }
+  return n_hits + batch_scalar(ps, radius, p, candidates + k, n - k, t_now,
+                               hit_particles + n_hits, hit_times + n_hits);
+}
+#endif // COLLISION_KERNEL_X86
+
+/**
+ * Static helper: the active level, initially the highest supported one.
+ */
+static simd_level_t &active_level()
+{
+  static simd_level_t level = CollisionKernel::max_level();
+  return level;
+}
+
+size_t CollisionKernel::batch(const ParticleStore *ps, particle_t p,
+                              const uint32_t *candidates, size_t n,
+                              float t_now, uint32_t *hit_particles,
+                              float *hit_times)
+{
+  return batch(ps, PerParticleRadius(), p, candidates, n, t_now,
+               hit_particles, hit_times);
+}
+
+template <typename Radius>
+size_t CollisionKernel::batch(const ParticleStore *ps, const Radius &radius,
+                              particle_t p, const uint32_t *candidates,
+                              size_t n, float t_now, uint32_t *hit_particles,
+                              float *hit_times)
+{
+  switch (active_level())
+  {
+#if COLLISION_KERNEL_X86
+  case SIMD_AVX512:
+    return batch_avx512(ps, radius, p, candidates, n, t_now, hit_particles,
+                        hit_times);
+  case SIMD_AVX2:
+    return batch_avx2(ps, radius, p, candidates, n, t_now, hit_particles,
+                      hit_times);
+  case SIMD_SSE2:
+    return batch_sse2(ps, radius, p, candidates, n, t_now, hit_particles,
+                      hit_times);
+#endif
+  default:
+    return batch_scalar(ps, radius, p, candidates, n, t_now, hit_particles,
+                        hit_times);
+  }
+}
+
+template collision_status_t
+CollisionKernel::time_of(const ParticleStore *, const PerParticleRadius &,
+                         particle_t, particle_t, float, float *);
+template collision_status_t
+CollisionKernel::time_of(const ParticleStore *, const UniformRadius &,
+                         particle_t, particle_t, float, float *);
+template size_t CollisionKernel::batch(const ParticleStore *,
+                                       const PerParticleRadius &, particle_t,
+                                       const uint32_t *, size_t, float,
+                                       uint32_t *, float *);
+template size_t CollisionKernel::batch(const ParticleStore *,
+                                       const UniformRadius &, particle_t,
+                                       const uint32_t *, size_t, float,
+                                       uint32_t *, float *);
+
+simd_level_t CollisionKernel::max_level()
+{
+#if COLLISION_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SIMD_SSE2;
+#endif
+  return SIMD_SCALAR;
+}
+
+simd_level_t CollisionKernel::level() { return active_level(); }
+
+p_sim_error_t CollisionKernel::set_level(simd_level_t level)
+{
+  if (level > max_level())
+    return ERR_INVALID_STATE;
+  active_level() = level;
+  return ERR_OK;
+}
+
+const char *CollisionKernel::level_name(simd_level_t level)
+{
+  switch (level)
+  {
+  case SIMD_SSE2:
+    return "sse2";
+  case SIMD_AVX2:
+    return "avx2";
+  case SIMD_AVX512:
+    return "avx512";
+  default:
+    return "scalar";
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef __COLLISIONKERNEL_HPP__
+#define __COLLISIONKERNEL_HPP__
+
+#include "ParticleStore.hpp"
+#include "PhysicsPolicy.hpp"
+#include "p_sim_error.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t simd_level_t;
+#define SIMD_SCALAR 0
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+#define SIMD_AVX512 3
+
+/**
+ * @brief Particle-particle time of collision, one particle against a block of
+ * candidates.
+ *
+ * The batch kernel evaluates several candidates per instruction (SSE2, AVX2
+ * or AVX-512, picked at run time from what the CPU supports) and only emits
+ * the hits. Every lane does exactly the float operations of `time_of()`, in
+ * the same order, so the batch results are bit-identical to the scalar path.
+ * The build disables FP contraction (-ffp-contract=off) to keep it that way.
+ *
+ * Both are also instantiated per radius policy (see PhysicsPolicy.hpp): with
+ * UniformRadius the contact distance is a constant instead of a per-pair
+ * gather and add.
+ */
+class CollisionKernel
+{
+public:
+  /**
+   * @brief Scalar time of collision between two particles.
+   *
+   * Both particles are extrapolated to the later of their `t_current`s
+   * (t_base); the returned time is relative to t_base. Overlapping pairs
+   * collide at once if approaching, and never if already separating.
+   *
+   * @param ps particle storage
+   * @param p_i the first particle
+   * @param p_j the second particle
+   * @param t_now current sim time (collisions past t = 1 are ignored)
+   * @param t_coll address of where to write collision time (from t_base)
+   * @return COLLISION_TRUE if collided, COLLISION_FALSE if not
+   */
+  static collision_status_t time_of(const ParticleStore *ps, particle_t p_i,
+                                    particle_t p_j, float t_now,
+                                    float *t_coll);
+
+  /** @brief `time_of()` with the contact distance given by a radius policy. */
+  template <typename Radius>
+  static collision_status_t time_of(const ParticleStore *ps,
+                                    const Radius &radius, particle_t p_i,
+                                    particle_t p_j, float t_now,
+                                    float *t_coll);
+
+  /**
+   * @brief Tests particle p against every candidate, writing the hits only.
+   *
+   * @param ps particle storage
+   * @param p particle to test
+   * @param candidates candidate particle handles (must not contain p)
+   * @param n number of candidates
+   * @param t_now current sim time
+   * @param hit_particles where to write the colliding candidates (room for n)
+   * @param hit_times where to write their collision times (room for n),
+   * relative to each pair's t_base as in `time_of()`
+   * @return number of hits
+   */
+  static size_t batch(const ParticleStore *ps, particle_t p,
+                      const uint32_t *candidates, size_t n, float t_now,
+                      uint32_t *hit_particles, float *hit_times);
+
+  /** @brief `batch()` with the contact distance given by a radius policy. */
+  template <typename Radius>
+  static size_t batch(const ParticleStore *ps, const Radius &radius,
+                      particle_t p, const uint32_t *candidates, size_t n,
+                      float t_now, uint32_t *hit_particles, float *hit_times);
+
+  /** @brief Instruction set used by `batch()`. */
+  static simd_level_t level();
+
+  /**
+   * @brief Overrides the instruction set used by `batch()` (e.g. to validate
+   * one against another).
+   * @param level requested level
+   * @return ERR_OK if successful, ERR_INVALID_STATE if the CPU (or build)
+   * does not support it
+   */
+  static p_sim_error_t set_level(simd_level_t level);
+
+  /** @brief Highest level supported by this CPU and build. */
+  static simd_level_t max_level();
+
+  /** @brief Printable name of a level ("scalar", "sse2", ...). */
+  static const char *level_name(simd_level_t level);
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __COLLISION_QUEUE_HPP__
+#define __COLLISION_QUEUE_HPP__
+
+#include "CollisionCalendar.hpp"
+#include "CollisionEvent.hpp"
+#include "CollisionHeap.hpp"
+#include "ParticleStore.hpp"
+#include <stdint.h>
+
+/*
+ * Event scheduler implementations, see CollisionQueue.
+ */
+typedef uint8_t queue_kind_t;
+#define QUEUE_HEAP 0     // indexed binary heap: O(log n) insert and pop
+#define QUEUE_CALENDAR 1 // calendar queue: O(1) amortized insert and pop
+
+/**
+ * @brief Event scheduler of a domain: (at most) one event per particle, the
+ * earliest popped first.
+ *
+ * Forwards to the implementation picked by `reset()` (a CollisionHeap or a
+ * CollisionCalendar, see `queue_kind_t`), which both keep each particle's
+ * event in a slot that can be replaced or removed in place. The kind is a
+ * run-time setting (`calendar_queue`), so the forwarding is a well-predicted
+ * branch rather than a virtual call.
+ */
+class CollisionQueue
+{
+private:
+  queue_kind_t kind;
+  CollisionHeap heap;
+  CollisionCalendar calendar;
+
+public:
+  CollisionQueue() : kind(QUEUE_HEAP) {}
+
+  /**
+   * @brief Empties the queue and sizes it for n particles.
+   * @param n number of particles (valid handles are 0 .. n-1)
+   * @param kind implementation to use from now on
+   */
+  void reset(size_t n, queue_kind_t kind)
+  {
+    this->kind = kind;
+    if (QUEUE_CALENDAR == kind)
+      this->calendar.reset(n);
+    else
+      this->heap.reset(n);
+  }
+
+  /** @brief Implementation in use. */
+  queue_kind_t get_kind() const { return this->kind; }
+
+  /** @brief Name of a queue implementation ("heap", "calendar"). */
+  static const char *kind_name(queue_kind_t kind)
+  {
+    return QUEUE_CALENDAR == kind ? "calendar" : "heap";
+  }
+
+  bool empty() const
+  {
+    return QUEUE_CALENDAR == this->kind ? this->calendar.empty()
+                                        : this->heap.empty();
+  }
+
+  size_t size() const
+  {
+    return QUEUE_CALENDAR == this->kind ? this->calendar.size()
+                                        : this->heap.size();
+  }
+
+  /** @brief Whether particle p currently has a scheduled event. */
+  bool contains(particle_t p) const
+  {
+    return QUEUE_CALENDAR == this->kind ? this->calendar.contains(p)
+                                        : this->heap.contains(p);
+  }
+
+  /** @brief Scheduled event of particle p (only valid if contains(p)). */
+  const CollisionEvent &get(particle_t p) const
+  {
+    return QUEUE_CALENDAR == this->kind ? this->calendar.get(p)
+                                        : this->heap.get(p);
+  }
+
+  /** @brief Earliest scheduled event. */
+  const CollisionEvent &top() const
+  {
+    return QUEUE_CALENDAR == this->kind ? this->calendar.top()
+                                        : this->heap.top();
+  }
+
+  /**
+   * @brief Sets the event of `event.particle_i`, inserting it or moving it in
+   * place.
+   * @param event event to schedule, owned by `event.particle_i`
+   */
+  void update(const CollisionEvent &event)
+  {
+    if (QUEUE_CALENDAR == this->kind)
+      this->calendar.update(event);
+    else
+      this->heap.update(event);
+  }
+
+  /**
+   * @brief Removes the scheduled event of particle p (if any).
+   * @param p particle handle
+   */
+  void remove(particle_t p)
+  {
+    if (QUEUE_CALENDAR == this->kind)
+      this->calendar.remove(p);
+    else
+      this->heap.remove(p);
+  }
+
+  /** @brief Removes the earliest scheduled event. */
+  void pop()
+  {
+    if (QUEUE_CALENDAR == this->kind)
+      this->calendar.pop();
+    else
+      this->heap.pop();
+  }
+
+  /**
+   * @brief Sets the event of `event.particle_i` without ordering it, for
+   * filling the queue in bulk. Call `build()` before using the queue again.
+   * @param event event to schedule, owned by `event.particle_i`
+   */
+  void put(const CollisionEvent &event)
+  {
+    if (QUEUE_CALENDAR == this->kind)
+      this->calendar.put(event);
+    else
+      this->heap.put(event);
+  }
+
+  /** @brief Orders the events after `put()`s, in linear time. */
+  void build()
+  {
+    if (QUEUE_CALENDAR == this->kind)
+      this->calendar.build();
+    else
+      this->heap.build();
+  }
+};
+
+#endif
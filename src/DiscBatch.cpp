@@ -0,0 +1,68 @@
+#include "DiscBatch.hpp"
+
+#ifndef HEADLESS
+#include <cmath>
+
+#include "config.h"
+
+DiscBatch::DiscBatch() : vertices(sf::PrimitiveType::Triangles)
+{
+  this->unit_circles.resize(RENDER_SEGMENTS_MAX + 1);
+}
+
+const std::vector<sf::Vector2f> &DiscBatch::unit_circle(uint32_t segments)
+{
+  std::vector<sf::Vector2f> &circle = this->unit_circles[segments];
+  if (circle.empty())
+  {
+    // segments + 1 points, so segment k spans points k and k + 1
+    for (uint32_t k = 0; k <= segments; k++)
+    {
+      float angle = (float)(2.0 * M_PI * k / segments);
+      circle.push_back(sf::Vector2f(std::cos(angle), std::sin(angle)));
+    }
+  }
+  return circle;
+}
+
+uint32_t DiscBatch::segments_for(float radius_px)
+{
+  float segments = std::ceil(2.0f * (float)M_PI * radius_px /
+                             RENDER_SEGMENT_LENGTH);
+  if (!(segments > RENDER_SEGMENTS_MIN)) // also catches NaN
+    return RENDER_SEGMENTS_MIN;
+  if (segments > RENDER_SEGMENTS_MAX)
+    return RENDER_SEGMENTS_MAX;
+  return (uint32_t)segments;
+}
+
+void DiscBatch::clear() { this->vertices.clear(); }
+
+void DiscBatch::add(sf::Vector2f center, float radius, float pixel_scale,
+                    sf::Color color)
+{
+  const std::vector<sf::Vector2f> &circle =
+      this->unit_circle(segments_for(radius * pixel_scale));
+  size_t segments = circle.size() - 1;
+  size_t base = this->vertices.getVertexCount();
+  this->vertices.resize(base + 3 * segments);
+  for (size_t k = 0; k < segments; k++)
+  {
+    sf::Vertex *tri = &this->vertices[base + 3 * k];
+    tri[0].position = center;
+    tri[1].position = center + circle[k] * radius;
+    tri[2].position = center + circle[k + 1] * radius;
+    tri[0].color = tri[1].color = tri[2].color = color;
+  }
+}
+
+p_sim_error_t DiscBatch::draw(sf::RenderWindow *window) const
+{
+  if (NULL == window)
+    return ERR_NULL_PTR;
+  if (this->vertices.getVertexCount() > 0)
+    window->draw(this->vertices);
+  return ERR_OK;
+}
+
+#endif // HEADLESS
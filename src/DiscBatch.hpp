@@ -0,0 +1,61 @@
+#ifndef __DISCBATCH_HPP__
+#define __DISCBATCH_HPP__
+
+#ifndef HEADLESS
+
+#include "p_sim_error.h"
+#include <SFML/Graphics.hpp>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Batches filled circles into a single vertex array (triangles), so
+ * any number of discs is submitted in one draw call.
+ *
+ * The vertex array is kept between frames; after the first frame, refilling
+ * it does not allocate. Each disc gets a segment count chosen from its
+ * on-screen radius, between RENDER_SEGMENTS_MIN and RENDER_SEGMENTS_MAX.
+ */
+class DiscBatch
+{
+private:
+  sf::VertexArray vertices;
+  // unit circle points, indexed by segment count (built on first use)
+  std::vector<std::vector<sf::Vector2f>> unit_circles;
+
+  const std::vector<sf::Vector2f> &unit_circle(uint32_t segments);
+
+public:
+  DiscBatch();
+
+  /**
+   * @brief Number of circle segments used for a disc of the given on-screen
+   * radius.
+   * @param radius_px disc radius in pixels
+   */
+  static uint32_t segments_for(float radius_px);
+
+  /** @brief Removes all discs (keeps the vertex storage). */
+  void clear();
+
+  /**
+   * @brief Appends a disc to the batch.
+   * @param center disc center (world coordinates)
+   * @param radius disc radius (world coordinates)
+   * @param pixel_scale pixels per world unit, used to pick the segment count
+   * @param color fill color
+   */
+  void add(sf::Vector2f center, float radius, float pixel_scale,
+           sf::Color color);
+
+  /**
+   * @brief Draws every disc in the batch with one draw call.
+   * @param window SFML window
+   * @return ERR_OK if successful
+   */
+  p_sim_error_t draw(sf::RenderWindow *window) const;
+};
+
+#endif // HEADLESS
+
+#endif
@@ -1,3 +1,18 @@
 #include "ParticleField.hpp"
 
+p_sim_error_t
+ParticleField::detect_edge_collisions(const ParticleStore *store,
+                                      particle_t begin, particle_t end,
+                                      std::vector<CollisionEvent> *cev)
+{
+  for (particle_t p = begin; p < end; p++)
+  {
+    p_sim_error_t res =
+        this->detect_edge_collision(store->t_current[p], store, p, cev);
+    if (ERR_OK != res)
+      return res;
+  }
+  return ERR_OK;
+}
+
 ParticleField::~ParticleField() {};
@@ -2,9 +2,12 @@
 #define __PARTICLEFIELD_HPP__
 
 #include "CollisionEvent.hpp"
-#include "Particle.hpp"
+#include "ParticleStore.hpp"
+#include "SimRandom.hpp"
 #include "p_sim_error.h"
-#include <SFML/Graphics.hpp>
+#ifndef HEADLESS
+  #include <SFML/Graphics.hpp>
+#endif
 
 /**
  * @brief ABSTRACT class denoting a particle field, for use in particle
@@ -16,38 +19,66 @@ public:
   /*
    * @brief Abstract function to generate N particles in the particle field.
    *
-   * @param p_list Where particles will be stored.
+   * @param store Where particles will be stored.
    * @param n_particles Number of particles to create
+   * @param rng random number generator to draw from
    * @return ERR_OK if successful.
    */
-  virtual p_sim_error_t init(std::vector<Particle *> *p_list,
-                             uint32_t n_particles) = 0;
+  virtual p_sim_error_t init(ParticleStore *store, uint32_t n_particles,
+                             SimRandom *rng) = 0;
   /*
    * @brief Abstract function to detect collisions with the field edge from t0
    * -> t1
    *
    * @param t_now current time
+   * @param store Particle storage
    * @param p Particle to check
    * @param cev Collision event vector to push to.
-   * @param t_delta Pointer to store t_delta
    * @return ERR_OK if check was successful (does not imply a collision)
    */
   virtual p_sim_error_t
-  detect_edge_collision(float t_now, Particle *p,
+  detect_edge_collision(float t_now, const ParticleStore *store, particle_t p,
                         std::vector<CollisionEvent> *cev) = 0;
+  /*
+   * @brief Detects collisions with the field edge for a range of particles,
+   * each from its own current time, as `detect_edge_collision()` would one by
+   * one (which is what this default does). Fields override it with a batch
+   * kernel.
+   *
+   * @param store Particle storage
+   * @param begin first particle to check
+   * @param end one past the last particle to check
+   * @param cev Collision event vector to push to.
+   * @return ERR_OK if the checks were successful
+   */
+  virtual p_sim_error_t
+  detect_edge_collisions(const ParticleStore *store, particle_t begin,
+                         particle_t end, std::vector<CollisionEvent> *cev);
+  /*
+   * @brief Abstract function to get the velocity change of a particle
+   * colliding with the field edge, where it is now (at its edge event).
+   *
+   * @param store Particle storage
+   * @param p Particle colliding
+   * @return velocity to add to the particle's
+   */
+  virtual sf::Vector2f edge_v_delta(const ParticleStore *store,
+                                    particle_t p) = 0;
+#ifndef HEADLESS
   /*
    * @brief Abstract function to render the particle field (mainly its boundary)
    * @param window SFML window reference
    * @return ERR_OK if successful.
    */
   virtual p_sim_error_t render(sf::RenderWindow *window) = 0;
+#endif
   /*
    * @brief Abstract function to flush a field state. Should be called
    * post-render.
    *
-   * For example, we use virtual particles to handle edge collisions in our sim.
-   * This will remove all virtual particles created during registration of edge
-   * collisions.
+   * For example, a field that handled edge collisions with virtual particles
+   * would remove the ones created while registering them. The circular field
+   * solves edge collisions directly and keeps no such state.
    *
    * @return ERR_OK if successful.
    */
@@ -1,87 +1,50 @@
 #include "ParticleFieldCircular.hpp"
+#include "CollisionKernel.hpp"
 #include "config.h"
 
-#include <cmath>   // for std::pow() and std::sqrt()
-#include <cstdlib> // for rand() and RAND_MAX
+#include <algorithm> // for std::nth_element()
+#include <cmath>     // for std::pow() and std::sqrt()
 
-/**
- * Static helper: generates a random float between min and max
- *
- * May be moved to a util class if we use it anywhere else
- *
- * @param min minimum float value
- * @param max maximum float value
- * @return a float value where (min <= value <= max)
- */
-static float rand_float(float min, float max)
-{
-  float rand_value = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-  return min + rand_value * (max - min);
-};
+#if COLLISION_KERNEL_SIMD && (defined(__x86_64__) || defined(__i386__)) &&   \
+    (defined(__GNUC__) || defined(__clang__))
+  #define EDGE_KERNEL_X86 1
+  #include <immintrin.h>
+#else
+  #define EDGE_KERNEL_X86 0
+#endif
 
-sf::Vector2f ParticleFieldCircular::edge_collision_v_delta(Particle p_1,
-                                                           float t_coll)
-{
-  p_1.advance(t_coll);
-  sf::Vector2f V = p_1.get_velocity();
-  sf::Vector2f P = p_1.get_position() - this->position;
-  float P_length = std::sqrt(P.x * P.x + P.y * P.y);
-  sf::Vector2f N = P / P_length;
-  float dot = V.x * N.x + V.y * N.y;
-  return -N * (2.0f * dot);
-}
+#define FIELD_INIT_DRAWS 5 // random numbers drawn per particle by init()
+#define SITE_GAP 1e-4f     // relative margin of site spacing over a diameter
+#define POISSON_TRIES 6     // candidates around a site before it is retired
+#define POISSON_DENSITY 0.7 // sites per spacing squared, filled field (low)
+#define POISSON_SHRINK 0.95 // spacing factor when the sites fall short
+#define EDGE_BLOCK 256      // particles per pass of the edge kernel
 
-collision_status_t ParticleFieldCircular::time_of_edge_collision(float t_max,
-                                                                 float *t_coll,
-                                                                 Particle *p)
+/**
+ * Static helper: keeps n of the sites, picked at random (from counter on of
+ * key), in their original order.
+ */
+static void drop_sites(uint32_t n, uint64_t key, uint64_t counter,
+                       std::vector<sf::Vector2f> *sites)
 {
-  if (!p || !t_coll)
-    return COLLISION_ERR;
-  *t_coll = 0.0f; // default collision value
-  sf::Vector2f vel = p->get_velocity();
-  sf::Vector2f pos = p->get_position();
-  float r = p->get_radius();
-  float R = this->radius - r;
-
-  // Arena too small / Particle too big
-  if (R <= 0.0f)
-    return COLLISION_TRUE;
-
-  sf::Vector2f dpos = pos - this->position;
-  float a = vel.x * vel.x + vel.y * vel.y;
-  float b = 2.0f * (dpos.x * vel.x + dpos.y * vel.y);
-  float c = dpos.x * dpos.x + dpos.y * dpos.y - R * R;
-  float discriminant = (b * b) - (4.0 * a * c);
-
-  // Not moving, practically
-  if (a < EPS)
-    return COLLISION_FALSE;
-
-  // Currently touching or outside
-  if (c >= N_EPS)
-    return COLLISION_TRUE;
-
-  // No solution - no collision.
-  if (discriminant < -1e-6f)
-    return COLLISION_FALSE;
-
-  // resolve t
-  float t = -1.0f;
-  float sqrt_disc = std::sqrt(discriminant);
-  float t1 = (-b - sqrt_disc) / (2.0f * a);
-  float t2 = (-b + sqrt_disc) / (2.0f * a);
-  if (t1 >= 0.0f)
-    t = t1;
-  else if (t2 >= 0.0f)
-    t = t2;
-
-  // t is either invalid, or in a different timestep
-  if (t < 0.0f || t > t_max + EPS)
-    return COLLISION_FALSE;
-
-  // collision looks good
-  *t_coll = t;
-  return COLLISION_TRUE;
+  size_t n_sites = sites->size();
+  if (n_sites <= n)
+    return;
+  // Random rank in the high bits, site in the low ones (all distinct)
+  std::vector<uint64_t> order(n_sites);
+  for (size_t i = 0; i < n_sites; i++)
+    order[i] = ((uint64_t)SimRandom::at(key, counter + i) << 32) | i;
+  std::nth_element(order.begin(), order.begin() + n, order.end());
+  std::vector<uint8_t> keep(n_sites, 0);
+  for (size_t k = 0; k < n; k++)
+    keep[order[k] & UINT32_MAX] = 1;
+  size_t kept = 0;
+  for (size_t i = 0; i < n_sites; i++)
+  {
+    if (keep[i])
+      (*sites)[kept++] = (*sites)[i];
+  }
+  sites->resize(kept);
 }
 
 ParticleFieldCircular::ParticleFieldCircular(sf::Vector2f position,
@@ -90,73 +53,449 @@ ParticleFieldCircular::ParticleFieldCircular(sf::Vector2f position,
   this->position = position;
   this->radius = radius;
   this->outline_color = color;
+  this->particle_radius_min = PARTICLE_RADIUS_MIN;
+  this->particle_radius_max = PARTICLE_RADIUS_MAX;
+  this->particle_v0_max = V0_MAX;
+  this->placement = PARTICLE_PLACEMENT;
+}
+
+ParticleFieldCircular::ParticleFieldCircular(const SimConfig &config,
+                                             sf::Color color)
+{
+  this->position = sf::Vector2f(config.field_center_x, config.field_center_y);
+  this->radius = config.field_radius;
+  this->outline_color = color;
+  this->particle_radius_min = config.radius_min;
+  this->particle_radius_max = config.radius_max;
+  this->particle_v0_max = config.v0_max;
+  this->placement = config.placement;
+}
+
+p_sim_error_t ParticleFieldCircular::set_particle_params(float radius_min,
+                                                         float radius_max,
+                                                         float v0_max)
+{
+  if (radius_min <= 0.0f || radius_max < radius_min || v0_max < 0.0f)
+    return ERR_INVALID_STATE;
+  if (radius_max >= this->radius)
+    return ERR_INVALID_STATE;
+  this->particle_radius_min = radius_min;
+  this->particle_radius_max = radius_max;
+  this->particle_v0_max = v0_max;
+  return ERR_OK;
+}
+
+p_sim_error_t ParticleFieldCircular::lattice_sites(
+    uint32_t n_particles, uint64_t key, std::vector<sf::Vector2f> *sites)
+{
+  // Centers stay clear of the edge, and sites a diameter (and a hair) apart
+  double r = this->radius - this->particle_radius_max - EPS;
+  double a_min = 2.0 * this->particle_radius_max * (1.0 + SITE_GAP);
+  if (!(r >= 0.0))
+    return ERR_NO_ROOM;
+  // Spacing that gives every particle an equal share of the disc, narrowed
+  // until the rows (rounded to whole sites) hold all of them
+  double a = std::sqrt(2.0 * M_PI * r * r / (std::sqrt(3.0) * n_particles));
+  a = std::max(a, a_min);
+  for (;;)
+  {
+    double h = a * std::sqrt(3.0) / 2.0;
+    int64_t rows = (int64_t)std::floor(r / h);
+    sites->clear();
+    for (int64_t j = -rows; j <= rows; j++)
+    {
+      double y = j * h;
+      double w = std::sqrt(std::max(0.0, r * r - y * y));
+      double offset = (j & 1) ? 0.5 * a : 0.0;
+      int64_t i_lo = (int64_t)std::ceil((-w - offset) / a);
+      int64_t i_hi = (int64_t)std::floor((w - offset) / a);
+      for (int64_t i = i_lo; i <= i_hi; i++)
+        sites->push_back(sf::Vector2f((float)(offset + i * a), (float)y));
+    }
+    if (sites->size() >= n_particles)
+      break;
+    if (a <= a_min)
+      return ERR_NO_ROOM;
+    a = std::max(a * 0.99, a_min);
+  }
+  drop_sites(n_particles, key, 0, sites);
+  return ERR_OK;
 }
 
-p_sim_error_t ParticleFieldCircular::init(std::vector<Particle *> *p_list,
-                                          uint32_t n_particles)
+p_sim_error_t ParticleFieldCircular::poisson_sites(
+    uint32_t n_particles, uint64_t key, std::vector<sf::Vector2f> *sites)
+{
+  double r = this->radius - this->particle_radius_max - EPS;
+  double d_min = 2.0 * this->particle_radius_max * (1.0 + SITE_GAP);
+  if (!(r >= 0.0))
+    return ERR_NO_ROOM;
+  // A spacing whose filled disc holds (a few more than) n sites, at least
+  double d = std::sqrt(POISSON_DENSITY * M_PI * r * r / n_particles);
+  d = std::max(d, d_min);
+  // Candidates around a site: evenly spread just beyond the spacing, which
+  // packs tighter and needs fewer tries than random ones in [d, 2d)
+  float dir_x[POISSON_TRIES], dir_y[POISSON_TRIES];
+  for (uint32_t t = 0; t < POISSON_TRIES; t++)
+  {
+    dir_x[t] = std::cos(2.0f * (float)M_PI * t / POISSON_TRIES);
+    dir_y[t] = std::sin(2.0f * (float)M_PI * t / POISSON_TRIES);
+  }
+  std::vector<uint32_t> grid;   // site of each cell + 1 (0: none)
+  std::vector<uint32_t> active; // sites that may still get neighbors
+  uint64_t counter = 0;
+  for (;;)
+  {
+    // Cells of d / sqrt(2) hold at most one site each
+    double cell = d / std::sqrt(2.0);
+    int64_t dim = (int64_t)std::ceil(2.0 * r / cell) + 1;
+    grid.assign((size_t)(dim * dim), 0);
+    sites->clear();
+    active.clear();
+    sites->push_back(sf::Vector2f(0.0f, 0.0f));
+    active.push_back(0);
+    grid[(size_t)((int64_t)(r / cell) * (dim + 1))] = 1;
+    float reach = (float)(d * (1.0 + SITE_GAP));
+    while (!active.empty())
+    {
+      // Grow from the newest site: the front stays compact in memory
+      sf::Vector2f s = (*sites)[active.back()];
+      float angle =
+          SimRandom::uniform_at(key, counter++, 0.0f, 2.0f * (float)M_PI);
+      float cos_a = reach * std::cos(angle);
+      float sin_a = reach * std::sin(angle);
+      bool placed = false;
+      for (uint32_t t = 0; t < POISSON_TRIES && !placed; t++)
+      {
+        sf::Vector2f c = s + sf::Vector2f(cos_a * dir_x[t] - sin_a * dir_y[t],
+                                          sin_a * dir_x[t] + cos_a * dir_y[t]);
+        if ((double)c.x * c.x + (double)c.y * c.y > r * r)
+          continue;
+        int64_t cx = (int64_t)((c.x + r) / cell);
+        int64_t cy = (int64_t)((c.y + r) / cell);
+        bool clear = true;
+        for (int64_t y = std::max<int64_t>(cy - 2, 0);
+             y <= std::min<int64_t>(cy + 2, dim - 1) && clear; y++)
+        {
+          for (int64_t x = std::max<int64_t>(cx - 2, 0);
+               x <= std::min<int64_t>(cx + 2, dim - 1); x++)
+          {
+            uint32_t o = grid[(size_t)(y * dim + x)];
+            if (0 == o)
+              continue;
+            sf::Vector2f diff = (*sites)[o - 1] - c;
+            if ((double)diff.x * diff.x + (double)diff.y * diff.y < d * d)
+            {
+              clear = false;
+              break;
+            }
+          }
+        }
+        if (!clear)
+          continue;
+        sites->push_back(c);
+        grid[(size_t)(cy * dim + cx)] = (uint32_t)sites->size();
+        active.push_back((uint32_t)sites->size() - 1);
+        placed = true;
+      }
+      if (!placed)
+        active.pop_back(); // s is surrounded
+    }
+    if (sites->size() >= n_particles)
+      break;
+    if (d <= d_min)
+      return ERR_NO_ROOM;
+    d = std::max(d * POISSON_SHRINK, d_min);
+  }
+  drop_sites(n_particles, key, counter, sites);
+  return ERR_OK;
+}
+
+p_sim_error_t ParticleFieldCircular::init(ParticleStore *store,
+                                          uint32_t n_particles, SimRandom *rng)
 {
   if (0 == n_particles)
     return ERR_INVALID_STATE;
+  if (NULL == store || NULL == rng)
+    return ERR_NULL_PTR;
+  size_t first = store->size();
+  size_t end = first + n_particles;
+  std::vector<sf::Vector2f> sites;
   try
   {
+    p_sim_error_t res = ERR_OK;
+    if (PLACEMENT_LATTICE == this->placement)
+      res = this->lattice_sites(n_particles, rng->next_key(), &sites);
+    else if (PLACEMENT_POISSON == this->placement)
+      res = this->poisson_sites(n_particles, rng->next_key(), &sites);
+    if (ERR_OK != res)
+      return res;
+    store->reserve(end);
     for (uint32_t i = 0; i < n_particles; i++)
+      store->add(this->position, 0.0f, PARTICLE_COLOR);
+  }
+  catch (...)
+  {
+    return ERR_FAIL;
+  }
+  // Every particle draws from its own counters, so any thread can place it
+  uint64_t key = rng->next_key();
+  float length_max = this->radius - this->particle_radius_max - EPS;
+  float v0_max = this->particle_v0_max;
+  bool random = sites.empty();
+  _Pragma("omp parallel for") for (size_t p = first; p < end; p++)
+  {
+    uint64_t c = (uint64_t)p * FIELD_INIT_DRAWS;
+    sf::Vector2f position;
+    if (random)
     {
-      float angle = (float)rand_float(0, 2 * M_PI);
-      float length = (float)rand_float(0, PARTICLE_FIELD_RADIUS -
-                                              PARTICLE_RADIUS_MAX - EPS);
-      float p_radius =
-          (float)rand_float(PARTICLE_RADIUS_MIN, PARTICLE_RADIUS_MAX);
-      sf::Vector2 position =
+      float angle = SimRandom::uniform_at(key, c, 0.0f, 2.0f * (float)M_PI);
+      float length = SimRandom::uniform_at(key, c + 1, 0.0f, length_max);
+      position =
           sf::Vector2f(length * std::cos(angle), length * std::sin(angle));
-      Particle *p =
-          new Particle(position + this->position, p_radius, PARTICLE_COLOR, i);
-      float rand_x = (float)rand_float(V0_MAX * -1.0f, V0_MAX);
-      float rand_y = (float)rand_float(V0_MAX * -1.0f, V0_MAX);
-      p->set_velocity(sf::Vector2f(rand_x, rand_y));
-      p_list->push_back(p);
     }
-    return ERR_OK;
+    else
+      position = sites[p - first];
+    float p_radius = SimRandom::uniform_at(
+        key, c + 2, this->particle_radius_min, this->particle_radius_max);
+    store->set_position((particle_t)p, position + this->position);
+    store->set_radius((particle_t)p, p_radius);
+    float rand_x = SimRandom::uniform_at(key, c + 3, -v0_max, v0_max);
+    float rand_y = SimRandom::uniform_at(key, c + 4, -v0_max, v0_max);
+    store->set_velocity((particle_t)p, sf::Vector2f(rand_x, rand_y));
   }
-  catch (...)
+  return ERR_OK;
+}
+
+#if EDGE_KERNEL_X86
+/*
+ * The SIMD edge kernels below mirror
+ * `ParticleFieldCircular::time_of_edge_collision()` lane by lane, with each
+ * particle's own t_current as t_now: same operands and operation order (the
+ * discriminant is taken in double precision there, so it is here too), and
+ * comparisons chosen to treat NaN the way the scalar branches do. They report
+ * the particles that collide, with their t_delta, for
+ * `register_edge_collision()` to check further. Each checks particles from
+ * begin on while a full vector remains, and sets *next to the first one left.
+ */
+
+__attribute__((target("sse2"))) static size_t
+edge_batch_sse2(const ParticleStore *ps, sf::Vector2f center, float radius,
+                particle_t begin, particle_t end, particle_t *next,
+                particle_t *hit_particles, float *hit_times)
+{
+  const float *x = ps->x.data(), *y = ps->y.data();
+  const float *vx = ps->vx.data(), *vy = ps->vy.data();
+  const float *r = ps->radius.data(), *tc = ps->t_current.data();
+  const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y);
+  const __m128 field_r = _mm_set1_ps(radius);
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f), eps = _mm_set1_ps(EPS);
+  const __m128 n_eps = _mm_set1_ps(N_EPS), disc_min = _mm_set1_ps(-1e-6f);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128d four = _mm_set1_pd(4.0);
+  size_t n_hits = 0;
+  particle_t p = begin;
+  for (; end - p >= 4; p += 4)
   {
-    return ERR_FAIL;
+    __m128 vxp = _mm_loadu_ps(vx + p), vyp = _mm_loadu_ps(vy + p);
+    __m128 R = _mm_sub_ps(field_r, _mm_loadu_ps(r + p));
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + p), cx);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + p), cy);
+    __m128 a = _mm_add_ps(_mm_mul_ps(vxp, vxp), _mm_mul_ps(vyp, vyp));
+    __m128 b = _mm_mul_ps(
+        two, _mm_add_ps(_mm_mul_ps(dx, vxp), _mm_mul_ps(dy, vyp)));
+    __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                          _mm_mul_ps(R, R));
+    __m128 bb = _mm_mul_ps(b, b);
+    __m128d disc_lo = _mm_sub_pd(
+        _mm_cvtps_pd(bb),
+        _mm_mul_pd(_mm_mul_pd(four, _mm_cvtps_pd(a)), _mm_cvtps_pd(c)));
+    __m128d disc_hi = _mm_sub_pd(
+        _mm_cvtps_pd(_mm_movehl_ps(bb, bb)),
+        _mm_mul_pd(_mm_mul_pd(four, _mm_cvtps_pd(_mm_movehl_ps(a, a))),
+                   _mm_cvtps_pd(_mm_movehl_ps(c, c))));
+    __m128 disc =
+        _mm_movelh_ps(_mm_cvtpd_ps(disc_lo), _mm_cvtpd_ps(disc_hi));
+    __m128 sqrt_disc = _mm_sqrt_ps(disc);
+    __m128 neg_b = _mm_xor_ps(b, sign);
+    __m128 two_a = _mm_mul_ps(two, a);
+    __m128 t1 = _mm_div_ps(_mm_sub_ps(neg_b, sqrt_disc), two_a);
+    __m128 t2 = _mm_div_ps(_mm_add_ps(neg_b, sqrt_disc), two_a);
+    __m128 t1_ok = _mm_cmpge_ps(t1, zero);
+    __m128 t2_ok = _mm_cmpge_ps(t2, zero);
+    __m128 t = _mm_or_ps(_mm_and_ps(t1_ok, t1), _mm_andnot_ps(t1_ok, t2));
+    __m128 t_max = _mm_sub_ps(one, _mm_loadu_ps(tc + p));
+
+    // Touching or outside (or no room in the field): t_delta 0
+    __m128 no_room = _mm_cmple_ps(R, zero);
+    __m128 moving = _mm_andnot_ps(no_room, _mm_cmpnlt_ps(a, eps));
+    __m128 hit_now = _mm_or_ps(no_room,
+                               _mm_and_ps(moving, _mm_cmpge_ps(c, n_eps)));
+    __m128 hit_later = _mm_and_ps(moving, _mm_cmpnge_ps(c, n_eps));
+    hit_later = _mm_and_ps(hit_later, _mm_cmpnlt_ps(disc, disc_min));
+    hit_later = _mm_and_ps(hit_later, _mm_or_ps(t1_ok, t2_ok));
+    hit_later = _mm_and_ps(
+        hit_later, _mm_cmpngt_ps(t, _mm_add_ps(t_max, eps)));
+    __m128 t_coll = _mm_andnot_ps(hit_now, t);
+
+    int mask = _mm_movemask_ps(_mm_or_ps(hit_now, hit_later));
+    if (mask)
+    {
+      alignas(16) float lanes[4];
+      _mm_store_ps(lanes, t_coll);
+      for (; mask; mask &= mask - 1)
+      {
+        int lane = __builtin_ctz(mask);
+        hit_particles[n_hits] = p + lane;
+        hit_times[n_hits] = lanes[lane];
+        n_hits++;
+      }
+    }
+  }
+  *next = p;
+  return n_hits;
+}
+
+__attribute__((target("avx2"))) static size_t
+edge_batch_avx2(const ParticleStore *ps, sf::Vector2f center, float radius,
+                particle_t begin, particle_t end, particle_t *next,
+                particle_t *hit_particles, float *hit_times)
+{
+  const float *x = ps->x.data(), *y = ps->y.data();
+  const float *vx = ps->vx.data(), *vy = ps->vy.data();
+  const float *r = ps->radius.data(), *tc = ps->t_current.data();
+  const __m256 cx = _mm256_set1_ps(center.x), cy = _mm256_set1_ps(center.y);
+  const __m256 field_r = _mm256_set1_ps(radius);
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f), eps = _mm256_set1_ps(EPS);
+  const __m256 n_eps = _mm256_set1_ps(N_EPS);
+  const __m256 disc_min = _mm256_set1_ps(-1e-6f);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  const __m256d four = _mm256_set1_pd(4.0);
+  size_t n_hits = 0;
+  particle_t p = begin;
+  for (; end - p >= 8; p += 8)
+  {
+    __m256 vxp = _mm256_loadu_ps(vx + p), vyp = _mm256_loadu_ps(vy + p);
+    __m256 R = _mm256_sub_ps(field_r, _mm256_loadu_ps(r + p));
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + p), cx);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + p), cy);
+    __m256 a =
+        _mm256_add_ps(_mm256_mul_ps(vxp, vxp), _mm256_mul_ps(vyp, vyp));
+    __m256 b = _mm256_mul_ps(
+        two, _mm256_add_ps(_mm256_mul_ps(dx, vxp), _mm256_mul_ps(dy, vyp)));
+    __m256 c = _mm256_sub_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+        _mm256_mul_ps(R, R));
+    __m256 bb = _mm256_mul_ps(b, b);
+    __m256d disc_lo = _mm256_sub_pd(
+        _mm256_cvtps_pd(_mm256_castps256_ps128(bb)),
+        _mm256_mul_pd(
+            _mm256_mul_pd(four, _mm256_cvtps_pd(_mm256_castps256_ps128(a))),
+            _mm256_cvtps_pd(_mm256_castps256_ps128(c))));
+    __m256d disc_hi = _mm256_sub_pd(
+        _mm256_cvtps_pd(_mm256_extractf128_ps(bb, 1)),
+        _mm256_mul_pd(
+            _mm256_mul_pd(four, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1))),
+            _mm256_cvtps_pd(_mm256_extractf128_ps(c, 1))));
+    __m256 disc = _mm256_insertf128_ps(
+        _mm256_castps128_ps256(_mm256_cvtpd_ps(disc_lo)),
+        _mm256_cvtpd_ps(disc_hi), 1);
+    __m256 sqrt_disc = _mm256_sqrt_ps(disc);
+    __m256 neg_b = _mm256_xor_ps(b, sign);
+    __m256 two_a = _mm256_mul_ps(two, a);
+    __m256 t1 = _mm256_div_ps(_mm256_sub_ps(neg_b, sqrt_disc), two_a);
+    __m256 t2 = _mm256_div_ps(_mm256_add_ps(neg_b, sqrt_disc), two_a);
+    __m256 t1_ok = _mm256_cmp_ps(t1, zero, _CMP_GE_OQ);
+    __m256 t2_ok = _mm256_cmp_ps(t2, zero, _CMP_GE_OQ);
+    __m256 t = _mm256_blendv_ps(t2, t1, t1_ok);
+    __m256 t_max = _mm256_sub_ps(one, _mm256_loadu_ps(tc + p));
+
+    // Touching or outside (or no room in the field): t_delta 0
+    __m256 no_room = _mm256_cmp_ps(R, zero, _CMP_LE_OQ);
+    __m256 moving =
+        _mm256_andnot_ps(no_room, _mm256_cmp_ps(a, eps, _CMP_NLT_UQ));
+    __m256 hit_now = _mm256_or_ps(
+        no_room, _mm256_and_ps(moving, _mm256_cmp_ps(c, n_eps, _CMP_GE_OQ)));
+    __m256 hit_later =
+        _mm256_and_ps(moving, _mm256_cmp_ps(c, n_eps, _CMP_NGE_UQ));
+    hit_later = _mm256_and_ps(hit_later,
+                              _mm256_cmp_ps(disc, disc_min, _CMP_NLT_UQ));
+    hit_later = _mm256_and_ps(hit_later, _mm256_or_ps(t1_ok, t2_ok));
+    hit_later = _mm256_and_ps(
+        hit_later,
+        _mm256_cmp_ps(t, _mm256_add_ps(t_max, eps), _CMP_NGT_UQ));
+    __m256 t_coll = _mm256_andnot_ps(hit_now, t);
+
+    int mask = _mm256_movemask_ps(_mm256_or_ps(hit_now, hit_later));
+    if (mask)
+    {
+      alignas(32) float lanes[8];
+      _mm256_store_ps(lanes, t_coll);
+      for (; mask; mask &= mask - 1)
+      {
+        int lane = __builtin_ctz(mask);
+        hit_particles[n_hits] = p + lane;
+        hit_times[n_hits] = lanes[lane];
+        n_hits++;
+      }
+    }
   }
+  *next = p;
+  return n_hits;
 }
+#endif // EDGE_KERNEL_X86
 
-p_sim_error_t
-ParticleFieldCircular::detect_edge_collision(float t_now, Particle *p,
-                                             std::vector<CollisionEvent> *cev)
+p_sim_error_t ParticleFieldCircular::detect_edge_collisions(
+    const ParticleStore *store, particle_t begin, particle_t end,
+    std::vector<CollisionEvent> *cev)
 {
-  collision_status_t res;
-  float t_delta = 0.0;
-  res = time_of_edge_collision(1.0f - t_now, &t_delta, p);
-  switch (res)
+  if (!store || !cev)
+    return ERR_NULL_PTR;
+  particle_t hit_particles[EDGE_BLOCK];
+  float hit_times[EDGE_BLOCK];
+  particle_t first = begin;
+  while (first < end)
   {
-  case COLLISION_ERR:
-    return ERR_COLLISION_CHECK_FAIL;
-    break;
-  case COLLISION_FALSE:
-    return ERR_OK;
-    break;
-  case COLLISION_TRUE:
-    float t_final = t_now + t_delta;
-    if (t_final <= p->edge_collision_time + EPS)
-      return ERR_OK; // final time is too soon from last collision
-    if (t_final > 1.0f + EPS)
-      return ERR_OK; // final time is out of bounds this timestep
-#ifdef DEBUG
-    printf("Registering edge collision ( %d ) @ t %0.3f\n", p->id, t_final);
+    particle_t last = end - first > EDGE_BLOCK ? first + EDGE_BLOCK : end;
+    particle_t next = first;
+    size_t n_hits = 0;
+    switch (CollisionKernel::level())
+    {
+#if EDGE_KERNEL_X86
+    case SIMD_AVX512: // no wider edge kernel
+    case SIMD_AVX2:
+      n_hits = edge_batch_avx2(store, this->position, this->radius, first,
+                               last, &next, hit_particles, hit_times);
+      break;
+    case SIMD_SSE2:
+      n_hits = edge_batch_sse2(store, this->position, this->radius, first,
+                               last, &next, hit_particles, hit_times);
+      break;
 #endif
-    sf::Vector2f v_delta = this->edge_collision_v_delta(*p, t_delta);
-    cev->push_back(CollisionEvent(
-        {t_final, CollisionType::EDGE, v_delta, p, NULL, p->version, -1}));
-    return ERR_OK;
-    break;
+    default:
+      break;
+    }
+    for (size_t k = 0; k < n_hits; k++)
+    {
+      particle_t p = hit_particles[k];
+      this->register_edge_collision(store->t_current[p], hit_times[k], store,
+                                    p, cev);
+    }
+    // The rest of the block (less than a vector, or all of it when scalar)
+    for (; next < last; next++)
+    {
+      p_sim_error_t res = this->detect_edge_collision(store->t_current[next],
+                                                      store, next, cev);
+      if (ERR_OK != res)
+        return res;
+    }
+    first = last;
   }
-  // If we reach this, something went very wrong
-  return ERR_INVALID_STATE;
+  return ERR_OK;
 }
 
+#ifndef HEADLESS
 p_sim_error_t ParticleFieldCircular::render(sf::RenderWindow *window)
 {
   if (NULL == window)
@@ -178,20 +517,10 @@ p_sim_error_t ParticleFieldCircular::render(sf::RenderWindow *window)
   }
   return ERR_OK;
 }
+#endif
 
 p_sim_error_t ParticleFieldCircular::flush_state()
 {
-  try
-  {
-    for (Particle *virtual_particle : this->virtual_particles)
-    {
-      delete virtual_particle;
-    }
-    this->virtual_particles.clear();
-  }
-  catch (...)
-  {
-    return ERR_FAIL;
-  }
+  // Edge collisions are solved against the boundary directly: no state
   return ERR_OK;
 }
@@ -2,30 +2,41 @@
 #define __PARTICLEFIELDCIRCULAR_HPP__
 
 #include "CollisionEvent.hpp"
-#include "Particle.hpp"
+#include "ParticleStore.hpp"
 #include "ParticleField.hpp"
+#include "SimConfig.hpp"
+#include "config.h"
 #include "p_sim_error.h"
-#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <stdio.h>
+#ifndef HEADLESS
+  #include <SFML/Graphics.hpp>
+#endif
 
 typedef int32_t edge_collision_res_t;
 
 /**
  * @brief A particle field bounded by a circular boundary.
  */
-class ParticleFieldCircular : public ParticleField
+class ParticleFieldCircular final : public ParticleField
 {
 private:
   sf::Color outline_color;
   sf::Vector2f position;
-  std::vector<Particle *> virtual_particles;
   float radius;
+  float particle_radius_min; // generated particle radius range
+  float particle_radius_max;
+  float particle_v0_max; // generated particle initial speed (per axis)
+  uint32_t placement;    // PLACEMENT_* of generated particles
 
   /**
    * @brief Calculates v_delta on collision of a particle with the field edge
-   * @param p particle reference
+   * @param store particle storage
+   * @param p particle handle
    * @param t_coll time of collision (needed for proper calculation)
    */
-  sf::Vector2f edge_collision_v_delta(Particle p, float t_coll);
+  sf::Vector2f edge_collision_v_delta(const ParticleStore *store, particle_t p,
+                                      float t_coll);
 
   /**
    * @brief Calculates the time (with respect to simulation timestep) of a
@@ -34,12 +45,63 @@ private:
    * @ param t_max maximum t_coll value
    * @ param t_coll where to store collision t_delta (if collision, 0.0 <=
    * *t_coll < 1.0)
-   * @ param p pointer to the particle in question
+   * @ param store particle storage
+   * @ param p handle of the particle in question
    * @ return COLLISION_TRUE if collided, COLLISION_FALSE if not, COLLISON_ERR
    * for error
    */
   collision_status_t time_of_edge_collision(float t_max, float *t_coll,
-                                            Particle *p);
+                                            const ParticleStore *store,
+                                            particle_t p);
+
+  /**
+   * @brief Registers a particle's edge collision found by
+   * `time_of_edge_collision()`, unless it is out of this timestep, too soon
+   * after the particle's last one, or grazing the edge.
+   *
+   * @param t_now current time of the particle
+   * @param t_delta time of the collision, from t_now
+   * @param store particle storage
+   * @param p handle of the particle
+   * @param cev collision event vector to push to
+   */
+  void register_edge_collision(float t_now, float t_delta,
+                               const ParticleStore *store, particle_t p,
+                               std::vector<CollisionEvent> *cev);
+
+  /**
+   * @brief Sites (relative to the field center) of a hexagonal lattice
+   * clipped to the field, with the widest spacing that holds n particles of
+   * the largest radius. Sites beyond n are dropped at random.
+   *
+   * @param n_particles number of sites
+   * @param key SimRandom key to drop sites with
+   * @param sites where to store the sites
+   * @return ERR_OK if successful, ERR_NO_ROOM if the particles do not fit
+   */
+  p_sim_error_t lattice_sites(uint32_t n_particles, uint64_t key,
+                              std::vector<sf::Vector2f> *sites);
+
+  /**
+   * @brief Sites (relative to the field center), no two closer than the
+   * spacing, which is as wide as still gives n sites and at least twice the
+   * largest radius. Extra sites are dropped at random.
+   *
+   * Grown from the center, always from the newest site that may still get a
+   * neighbor: POISSON_TRIES candidates evenly spread around it, just beyond
+   * the spacing and rotated by one random angle, are checked against a
+   * background grid, and the first that fits is taken. Unlike Bridson's
+   * algorithm (random candidates in [d, 2d) around a random active site),
+   * this packs tighter and needs fewer tries, but the sites come out less
+   * uniformly random (no blue-noise spectrum).
+   *
+   * @param n_particles number of sites
+   * @param key SimRandom key to sample with
+   * @param sites where to store the sites
+   * @return ERR_OK if successful, ERR_NO_ROOM if the particles do not fit
+   */
+  p_sim_error_t poisson_sites(uint32_t n_particles, uint64_t key,
+                              std::vector<sf::Vector2f> *sites);
 
 public:
   /**
@@ -52,14 +114,163 @@ public:
    */
   ParticleFieldCircular(sf::Vector2f position, float radius, sf::Color);
 
+  /**
+   * @brief Particle Field (Circular) constructor from a sim config: field
+   * center and radius, and particle generation parameters.
+   *
+   * @param config sim config
+   * @param color color of field boundary
+   * @return ParticleFieldCircular instance
+   */
+  ParticleFieldCircular(const SimConfig &config, sf::Color color);
+
+  /**
+   * @brief Overrides the particle generation parameters used by `init()`.
+   * Defaults are PARTICLE_RADIUS_MIN, PARTICLE_RADIUS_MAX and V0_MAX.
+   *
+   * @param radius_min minimum particle radius
+   * @param radius_max maximum particle radius
+   * @param v0_max maximum initial velocity along each axis
+   * @return ERR_OK if successful.
+   */
+  p_sim_error_t set_particle_params(float radius_min, float radius_max,
+                                    float v0_max);
+
   /** Abstract function overrides **/
-  p_sim_error_t init(std::vector<Particle *> *p_list,
-                     uint32_t n_particles) override;
+  p_sim_error_t init(ParticleStore *store, uint32_t n_particles,
+                     SimRandom *rng) override;
   p_sim_error_t
-  detect_edge_collision(float t_now, Particle *p,
+  detect_edge_collision(float t_now, const ParticleStore *store, particle_t p,
                         std::vector<CollisionEvent> *cev) override;
+  p_sim_error_t
+  detect_edge_collisions(const ParticleStore *store, particle_t begin,
+                         particle_t end,
+                         std::vector<CollisionEvent> *cev) override;
+  sf::Vector2f edge_v_delta(const ParticleStore *store, particle_t p) override;
+#ifndef HEADLESS
   p_sim_error_t render(sf::RenderWindow *window) override;
+#endif
   p_sim_error_t flush_state() override;
 };
 
+/*
+ * Edge collision math, inline so that code holding a ParticleFieldCircular
+ * (not just a ParticleField) can call it without a virtual dispatch.
+ */
+
+inline sf::Vector2f ParticleFieldCircular::edge_collision_v_delta(
+    const ParticleStore *store, particle_t p, float t_coll)
+{
+  sf::Vector2f V = store->get_velocity(p);
+  sf::Vector2f P = store->get_position(p) + t_coll * V - this->position;
+  float P_length = std::sqrt(P.x * P.x + P.y * P.y);
+  sf::Vector2f N = P / P_length;
+  float dot = V.x * N.x + V.y * N.y;
+  return -N * (2.0f * dot);
+}
+
+inline collision_status_t
+ParticleFieldCircular::time_of_edge_collision(float t_max, float *t_coll,
+                                              const ParticleStore *store,
+                                              particle_t p)
+{
+  if (!store || !t_coll)
+    return COLLISION_ERR;
+  *t_coll = 0.0f; // default collision value
+  sf::Vector2f vel = store->get_velocity(p);
+  sf::Vector2f pos = store->get_position(p);
+  float r = store->radius[p];
+  float R = this->radius - r;
+
+  // Arena too small / Particle too big
+  if (R <= 0.0f)
+    return COLLISION_TRUE;
+
+  sf::Vector2f dpos = pos - this->position;
+  float a = vel.x * vel.x + vel.y * vel.y;
+  float b = 2.0f * (dpos.x * vel.x + dpos.y * vel.y);
+  float c = dpos.x * dpos.x + dpos.y * dpos.y - R * R;
+  float discriminant = (b * b) - (4.0 * a * c);
+
+  // Not moving, practically
+  if (a < EPS)
+    return COLLISION_FALSE;
+
+  // Currently touching or outside
+  if (c >= N_EPS)
+    return COLLISION_TRUE;
+
+  // No solution - no collision.
+  if (discriminant < -1e-6f)
+    return COLLISION_FALSE;
+
+  // resolve t
+  float t = -1.0f;
+  float sqrt_disc = std::sqrt(discriminant);
+  float t1 = (-b - sqrt_disc) / (2.0f * a);
+  float t2 = (-b + sqrt_disc) / (2.0f * a);
+  if (t1 >= 0.0f)
+    t = t1;
+  else if (t2 >= 0.0f)
+    t = t2;
+
+  // t is either invalid, or in a different timestep
+  if (t < 0.0f || t > t_max + EPS)
+    return COLLISION_FALSE;
+
+  // collision looks good
+  *t_coll = t;
+  return COLLISION_TRUE;
+}
+
+inline p_sim_error_t ParticleFieldCircular::detect_edge_collision(
+    float t_now, const ParticleStore *store, particle_t p,
+    std::vector<CollisionEvent> *cev)
+{
+  collision_status_t res;
+  float t_delta = 0.0;
+  res = time_of_edge_collision(1.0f - t_now, &t_delta, store, p);
+  switch (res)
+  {
+  case COLLISION_ERR:
+    return ERR_COLLISION_CHECK_FAIL;
+    break;
+  case COLLISION_FALSE:
+    return ERR_OK;
+    break;
+  case COLLISION_TRUE:
+    this->register_edge_collision(t_now, t_delta, store, p, cev);
+    return ERR_OK;
+    break;
+  }
+  // If we reach this, something went very wrong
+  return ERR_INVALID_STATE;
+}
+
+inline void ParticleFieldCircular::register_edge_collision(
+    float t_now, float t_delta, const ParticleStore *store, particle_t p,
+    std::vector<CollisionEvent> *cev)
+{
+  float t_final = t_now + t_delta;
+  if (t_final <= store->edge_collision_time[p] + EPS)
+    return; // final time is too soon from last collision
+  if (t_final > 1.0f + EPS)
+    return; // final time is out of bounds this timestep
+  sf::Vector2f v_delta = this->edge_collision_v_delta(store, p, t_delta);
+  if (std::hypot(v_delta.x, v_delta.y) < EPS)
+    return; // grazing the edge, nothing to apply
+#ifdef DEBUG
+  printf("Registering edge collision ( %u ) @ t %0.3f\n", p, t_final);
+#endif
+  cev->push_back(CollisionEvent(
+      {t_final, p, PARTICLE_NONE,
+       CollisionEvent::version_tag(store->version[p]), 0}));
+}
+
+inline sf::Vector2f
+ParticleFieldCircular::edge_v_delta(const ParticleStore *store, particle_t p)
+{
+  return this->edge_collision_v_delta(store, p, 0.0f);
+}
+
 #endif
@@ -1,275 +1,634 @@
 #include "ParticleSim.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <stdexcept>
 
 #ifdef USE_OPENMP
   #include <omp.h>
 #endif
 
-#ifdef DEBUG
-  #include <stdio.h>
-#endif
+// Relative slack on contact distances when checking paths across domains
+#define WINDOW_CONTACT_SLACK 1e-3f
+
+/**
+ * @brief Adds a domain's counters to the totals, and clears them.
+ */
+static void add_counters(sim_counters_t *total, sim_counters_t *c)
+{
+  total->pair_tests += c->pair_tests;
+  total->edge_tests += c->edge_tests;
+  total->events_pushed += c->events_pushed;
+  total->events_popped += c->events_popped;
+  total->events_stale += c->events_stale;
+  total->collisions += c->collisions;
+  total->redetections += c->redetections;
+  total->queue_depth_max = std::max(total->queue_depth_max,
+                                    c->queue_depth_max);
+  *c = sim_counters_t();
+}
 
-bool ParticleSim::collision_is_valid(CollisionEvent event)
+/**
+ * @brief Seconds since t0, added to *total; returns the current time.
+ */
+static std::chrono::steady_clock::time_point
+lap(double *total, std::chrono::steady_clock::time_point t0)
 {
-  if (NULL == event.particle_i)
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  *total += std::chrono::duration<double>(t1 - t0).count();
+  return t1;
+}
+
+bool ParticleSim::collision_is_valid(sim_domain_t *d, CollisionEvent event)
+{
+  const ParticleStore &ps = this->particles;
+  if (event.particle_i >= ps.size())
     return false;
-  if (event.version_i < event.particle_i->version)
+  if (event.version_i !=
+      CollisionEvent::version_tag(ps.version[event.particle_i]))
     return false;
-  if (this->t_now > event.time)
+  if (d->t_now > event.time)
     return false;
   if (event.time > 1.0f)
     return false; // event.time is absolute
-  if (event.type == CollisionType::PARTICLE)
+  if (event.type() == CollisionType::PARTICLE)
   {
-    if (NULL == event.particle_j)
-      return false;
-    if (event.version_j < event.particle_j->version)
+    if (event.particle_j >= ps.size())
       return false;
-  }
-  if (event.type == CollisionType::EDGE)
-  {
-    sf::Vector2f v_delta = event.v_delta;
-    float mag = std::sqrt((v_delta.x * v_delta.x) + (v_delta.y * v_delta.y));
-    if (std::abs(mag) < EPS)
+    if (event.version_j !=
+        CollisionEvent::version_tag(ps.version[event.particle_j]))
       return false;
   }
   return true;
 }
 
-p_sim_error_t ParticleSim::advance_time(float t_delta)
+p_sim_error_t ParticleSim::advance_time(sim_domain_t *d, float t_delta)
 {
-  if (t_delta + this->t_now > 1.0f)
-    this->t_now = 1.0f;
+  if (t_delta + d->t_now > 1.0f)
+    d->t_now = 1.0f;
   else
-    this->t_now += t_delta;
+    d->t_now += t_delta;
   return ERR_OK;
 }
 
-collision_status_t ParticleSim::time_of_particle_collision(float *t_coll,
-                                                           Particle *p_i,
-                                                           Particle *p_j)
+collision_status_t ParticleSim::time_of_particle_collision(sim_domain_t *d,
+                                                           float *t_coll,
+                                                           particle_t p_i,
+                                                           particle_t p_j)
 {
-  if (NULL == t_coll)
+  return CollisionKernel::time_of(&this->particles, p_i, p_j, d->t_now,
+                                  t_coll);
+}
+
+collision_status_t
+ParticleSim::check_for_edge_collision(particle_t p,
+                                      std::vector<CollisionEvent> *cev)
+{
+  collision_status_t res = COLLISION_FALSE;
+  p_sim_error_t detect_res;
+  size_t cev_size;
+  float t_now = this->particles.t_current[p];
+  if (this->circular)
+    detect_res = this->circular->detect_edge_collision(t_now, &this->particles,
+                                                       p, cev);
+  else
+    detect_res =
+        this->field->detect_edge_collision(t_now, &this->particles, p, cev);
+  cev_size = cev->size();
+  if (ERR_OK != detect_res)
     return COLLISION_ERR;
-  sf::Vector2f dp = p_i->get_position() - p_j->get_position();
-  sf::Vector2f dv = p_i->get_velocity() - p_j->get_velocity();
-  float R = p_i->get_radius() + p_j->get_radius();
-  float R_sq = R * R;
-  float A = (dv.x * dv.x) + (dv.y * dv.y);          // dv * dv
-  float B = ((dp.x * dv.x) + (dp.y * dv.y)) * 2.0f; // dp * dv
-  float C = ((dp.x * dp.x) + (dp.y * dp.y)) - R_sq; // position differential
-  if (C <= 0.0f)
-    return COLLISION_TRUE; // not overlapping
-  if (A < 1e-9)
-    return COLLISION_FALSE;        // no relative motion (never will overlap)
-  float D = (B * B) - (4 * A * C); // discriminant
-  if (D < 0.0f)
-    return COLLISION_FALSE;    // no solution
-  float sqrt_D = std::sqrt(D); // disc. sqrt
-  float t1 = (-B - sqrt_D) / (2.0 * A);
-  float t2 = (-B + sqrt_D) / (2.0 * A);
-  float t_delta;
-  if (t1 >= 0.0f)
-  {
-    t_delta = t1;
-    if (t2 >= 0.0f && t2 < t1)
+  if (cev_size > 0)
+  {
+    res = COLLISION_TRUE;
+  }
+  return res;
+}
+
+p_sim_error_t
+ParticleSim::check_for_edge_collisions(particle_t begin, particle_t end,
+                                       std::vector<CollisionEvent> *cev)
+{
+  if (this->circular)
+    return this->circular->detect_edge_collisions(&this->particles, begin,
+                                                  end, cev);
+  return this->field->detect_edge_collisions(&this->particles, begin, end,
+                                             cev);
+}
+
+void ParticleSim::candidate_box(particle_t p, sf::Vector2f *lo,
+                                sf::Vector2f *hi)
+{
+  const ParticleStore &ps = this->particles;
+  sf::Vector2f a = ps.get_position(p);
+  sf::Vector2f b = a + ps.get_velocity(p) * (1.0f - ps.t_current[p]);
+  // Any binned particle is within v_max of its bin position until t = 1
+  float pad = ps.radius[p] + this->r_max + this->v_max;
+  *lo = sf::Vector2f(std::min(a.x, b.x) - pad, std::min(a.y, b.y) - pad);
+  *hi = sf::Vector2f(std::max(a.x, b.x) + pad, std::max(a.y, b.y) + pad);
+}
+
+void ParticleSim::build_neighbors(float reach)
+{
+  const ParticleStore &ps = this->particles;
+  size_t n = ps.size();
+  this->neighbor_start.resize(n + 1);
+  this->neighbor_x0.assign(ps.x.begin(), ps.x.end());
+  this->neighbor_y0.assign(ps.y.begin(), ps.y.end());
+  this->neighbor_reach = reach;
+  _Pragma("omp parallel")
+  {
+    uint32_t thread = 0;
+#ifdef USE_OPENMP
+    thread = (uint32_t)omp_get_thread_num();
+#endif
+    detect_scratch_t &scratch = this->thread_scratch[thread];
+    std::vector<uint32_t> &candidates = scratch.candidates;
+    scratch.neighbors.clear();
+    size_t first = n; // of this thread's (contiguous) block of particles
+    _Pragma("omp for schedule(static)") for (size_t i = 0; i < n; i++)
+    {
+      if (first == n)
+        first = i;
+      particle_t p = (particle_t)i;
+      sf::Vector2f pos = ps.get_position(p);
+      float pad = ps.radius[p] + this->r_max + reach;
+      candidates.clear();
+      for (const sim_domain_t &domain : this->domains)
+        domain.grid.query(pos - sf::Vector2f(pad, pad),
+                          pos + sf::Vector2f(pad, pad), &candidates);
+      size_t listed = scratch.neighbors.size();
+      for (particle_t o : candidates)
+      {
+        float dx = ps.x[o] - pos.x;
+        float dy = ps.y[o] - pos.y;
+        float reach_o = ps.radius[p] + ps.radius[o] + reach;
+        if (o != p && dx * dx + dy * dy <= reach_o * reach_o)
+          scratch.neighbors.push_back(o);
+      }
+      this->neighbor_start[i + 1] = (uint32_t)(scratch.neighbors.size() -
+                                               listed);
+    }
+    // Every thread's lists go in one flat array, in particle order
+    _Pragma("omp single")
     {
-      t_delta = t2;
+      this->neighbor_start[0] = 0;
+      for (size_t i = 0; i < n; i++)
+        this->neighbor_start[i + 1] += this->neighbor_start[i];
+      this->neighbors.resize(this->neighbor_start[n]);
     }
+    if (first < n)
+      std::copy(scratch.neighbors.begin(), scratch.neighbors.end(),
+                this->neighbors.begin() + this->neighbor_start[first]);
   }
-  else if (t2 >= 0.0f)
+}
+
+size_t ParticleSim::check_for_particle_collisions(
+    sim_domain_t *d, particle_t p, bool lower_only, detect_scratch_t *scratch,
+    std::vector<CollisionEvent> *cev)
+{
+  const ParticleStore &ps = this->particles;
+  std::vector<uint32_t> &candidates = scratch->candidates;
+  sf::Vector2f lo, hi;
+  size_t n_tests = 0;
+  candidates.clear();
+  bool leaked = false;
+  if (this->neighbors_valid)
   {
-    t_delta = t2;
-    if (t1 >= 0.0f && t1 < t2)
+    const particle_t *list = this->neighbors.data() + this->neighbor_start[p];
+    const particle_t *end =
+        this->neighbors.data() + this->neighbor_start[p + 1];
+    if (this->windowed)
     {
-      t_delta = t1;
+      for (; list < end; list++)
+      {
+        if (this->owner[*list] == d->id)
+          candidates.push_back(*list);
+        else
+          leaked = true;
+      }
     }
+    else
+      candidates.insert(candidates.end(), list, end);
   }
   else
   {
-    return COLLISION_FALSE;
+    this->candidate_box(p, &lo, &hi);
+    if (this->windowed)
+    {
+      d->grid.query(lo, hi, &candidates);
+      leaked = lo.x < d->x_lo || hi.x >= d->x_hi;
+    }
+    else
+    {
+      for (const sim_domain_t &domain : this->domains)
+        domain.grid.query(lo, hi, &candidates);
+    }
   }
-  if (t_delta + this->t_now > 1.0f)
+  // Other domains are busy while windowed: only our own particles are seen,
+  // so remember p if one of theirs could be in reach
+  if (leaked && this->leaked_in[p] != this->window)
   {
-    return COLLISION_FALSE;
+    this->leaked_in[p] = this->window;
+    d->leaked.push_back(p);
   }
-  *t_coll = t_delta;
-  return COLLISION_TRUE;
+  for (particle_t o : candidates)
+  {
+    if (o == p || (lower_only && o >= p))
+      continue;
+    candidates[n_tests++] = o;
+  }
+  candidates.resize(n_tests);
+  scratch->hit_particles.resize(n_tests);
+  scratch->hit_times.resize(n_tests);
+  size_t n_hits;
+  if (this->physics & PHYSICS_UNIFORM)
+    n_hits = CollisionKernel::batch(
+        &ps, this->uniform_radius, p, candidates.data(), n_tests, d->t_now,
+        scratch->hit_particles.data(), scratch->hit_times.data());
+  else
+    n_hits = CollisionKernel::batch(
+        &ps, p, candidates.data(), n_tests, d->t_now,
+        scratch->hit_particles.data(), scratch->hit_times.data());
+#ifdef DEBUG
+  // Validate the batch kernel against the scalar path (must be identical)
+  size_t n_scalar = 0;
+  for (particle_t o : candidates)
+  {
+    float t_coll;
+    if (COLLISION_TRUE != time_of_particle_collision(d, &t_coll, p, o))
+      continue;
+    if (n_scalar >= n_hits || scratch->hit_particles[n_scalar] != o ||
+        scratch->hit_times[n_scalar] != t_coll)
+      printf("Kernel mismatch (%s): %u vs %u\n",
+             CollisionKernel::level_name(CollisionKernel::level()), p, o);
+    n_scalar++;
+  }
+  if (n_scalar != n_hits)
+    printf("Kernel hit count mismatch: %lu vs %lu\n", n_hits, n_scalar);
+#endif
+  for (size_t h = 0; h < n_hits; h++)
+  {
+    particle_t o = scratch->hit_particles[h];
+    float t_base = ps.t_current[p] > ps.t_current[o] ? ps.t_current[p]
+                                                     : ps.t_current[o];
+    CollisionEvent event;
+    event.time = t_base + scratch->hit_times[h];
+    event.particle_i = p;
+    event.particle_j = o;
+    event.version_i = CollisionEvent::version_tag(ps.version[p]);
+    event.version_j = CollisionEvent::version_tag(ps.version[o]);
+    cev->push_back(event);
+  }
+  return n_tests;
+}
+
+/**
+ * @brief End of timestep filter: whether a predicted event happens by t = 1
+ * (later ones are found again next timestep). Edge events were already
+ * filtered further when registered, see `register_edge_collision()`.
+ */
+static bool in_timestep(const CollisionEvent &event)
+{
+  return !(event.time > 1.0f);
+}
+
+/**
+ * @brief The same particle-particle event, as seen from the other particle.
+ */
+static CollisionEvent mirror(const CollisionEvent &event)
+{
+  CollisionEvent mirrored = event;
+  mirrored.particle_i = event.particle_j;
+  mirrored.particle_j = event.particle_i;
+  mirrored.version_i = event.version_j;
+  mirrored.version_j = event.version_i;
+  return mirrored;
+}
+
+void ParticleSim::schedule_event(sim_domain_t *d, const CollisionEvent &event)
+{
+  if (!in_timestep(event))
+    return;
+  particle_t p_i = event.particle_i;
+  CollisionQueue *cq = &this->domains[this->owner[p_i]].queue;
+  if (!cq->contains(p_i) || cq->get(p_i) > event)
+  {
+    this->touch(p_i);
+    cq->update(event);
+    d->counters.events_pushed++;
+    d->counters.queue_depth_max =
+        std::max<uint64_t>(d->counters.queue_depth_max, cq->size());
+  }
+  if (event.type() != CollisionType::PARTICLE)
+    return;
+  CollisionEvent mirrored = mirror(event);
+  particle_t p_j = mirrored.particle_i;
+  cq = &this->domains[this->owner[p_j]].queue;
+  if (!cq->contains(p_j) || cq->get(p_j) > mirrored)
+  {
+    this->touch(p_j);
+    cq->update(mirrored);
+    d->counters.events_pushed++;
+    d->counters.queue_depth_max =
+        std::max<uint64_t>(d->counters.queue_depth_max, cq->size());
+  }
+}
+
+void ParticleSim::seed_queue(sim_domain_t *d)
+{
+  CollisionQueue &cq = d->queue;
+  for (const std::vector<CollisionEvent> &events : this->detected)
+  {
+    for (const CollisionEvent &event : events)
+    {
+      if (!in_timestep(event))
+        continue;
+      // Same rule as schedule_event(): each particle keeps its earliest
+      CollisionEvent offers[2] = {event, event};
+      int n_offers = 1;
+      if (event.type() == CollisionType::PARTICLE)
+        offers[n_offers++] = mirror(event);
+      for (int k = 0; k < n_offers; k++)
+      {
+        particle_t p = offers[k].particle_i;
+        if (this->owner[p] != d->id ||
+            (cq.contains(p) && !(cq.get(p) > offers[k])))
+          continue;
+        cq.put(offers[k]);
+        d->counters.events_pushed++;
+      }
+    }
+  }
+  cq.build();
+  d->counters.queue_depth_max =
+      std::max<uint64_t>(d->counters.queue_depth_max, cq.size());
+}
+
+void ParticleSim::touch(particle_t p)
+{
+  if (!this->windowed || this->touched_in[p] == this->window)
+    return;
+  sim_domain_t &home = this->domains[this->owner[p]];
+  this->touched_in[p] = this->window;
+  this->undo_slot[p] = (uint32_t)home.undo.size();
+  home.undo.push_back(this->particles.save(p));
+  CollisionEvent none;
+  none.particle_i = PARTICLE_NONE;
+  home.undo_event.push_back(home.queue.contains(p) ? home.queue.get(p) : none);
 }
 
+template <typename PairPhysics>
 collision_status_t
-ParticleSim::check_for_edge_collision(Particle *p,
-                                      std::vector<CollisionEvent> *cev)
+ParticleSim::collide_particles(sim_domain_t *d, const CollisionEvent &event,
+                               const PairPhysics &physics)
 {
-  collision_status_t res = COLLISION_FALSE;
-  p_sim_error_t detect_res;
-  size_t cev_size;
-  detect_res = this->field->detect_edge_collision(p->t_current, p, cev);
-  cev_size = cev->size();
-  if (ERR_OK != detect_res)
-    return COLLISION_ERR;
-  if (cev_size > 0)
+  ParticleStore &ps = this->particles;
+  particle_t p_i = event.particle_i;
+  particle_t p_j = event.particle_j;
+  float collision_time = event.time;
+#ifdef DEBUG
+  printf("Particle collision\n");
+#endif
+  this->touch(p_j);
+  this->advance_time(d, collision_time - d->t_now);
+  ps.advance(p_i, collision_time - ps.t_current[p_i]);
+  ps.advance(p_j, collision_time - ps.t_current[p_j]);
+  // resolve collision along the contact normal
+  sf::Vector2f dp = ps.get_position(p_i) - ps.get_position(p_j);
+  float dp_length = std::sqrt(dp.x * dp.x + dp.y * dp.y);
+  sf::Vector2f n = sf::Vector2f(dp.x / dp_length, dp.y / dp_length);
+  sf::Vector2f dv = ps.get_velocity(p_i) - ps.get_velocity(p_j);
+  float dv_dot_n = (dv.x * n.x + dv.y * n.y);
+  if (dv_dot_n >= 0.0f)
+    return COLLISION_FALSE;
+  float elastic_c = physics.elasticity.coeff();
+#ifdef DEBUG
+  // check for conservation of momentum
+  float m_0 = ps.mass[p_i], m_1 = ps.mass[p_j];
+  sf::Vector2f v_i, v_j, mom_0, mom_1, mom_diff;
+  v_i = ps.get_velocity(p_i);
+  v_j = ps.get_velocity(p_j);
+  mom_0 = v_i * m_0 + v_j * m_1;
+#endif
+  // After impulse application, push overlapping particles apart
+  const float total_r = physics.radius.contact(&ps, p_i, p_j);
+  const float penetration = total_r - dp_length + 0.001f;
+  const float correction_factor = 0.8f; // 80% fix per collision
+  if constexpr (PairPhysics::Mass::EQUAL)
   {
-    res = COLLISION_TRUE;
+    // Half the impulse each: elastic, the normal velocities are swapped
+    sf::Vector2f impulse = n * (-(1.0f + elastic_c) * 0.5f * dv_dot_n);
+    ps.add_velocity(p_i, impulse);
+    ps.add_velocity(p_j, -impulse);
+    if (penetration > 0.0f)
+    {
+      sf::Vector2f correction = n * (penetration * correction_factor * 0.5f);
+      ps.set_position(p_i, ps.get_position(p_i) + correction);
+      ps.set_position(p_j, ps.get_position(p_j) - correction);
+    }
   }
-  return res;
+  else
+  {
+    float m_i = ps.mass[p_i];
+    float m_j = ps.mass[p_j];
+    float inv_mass_sum = 1.0f / (m_i + m_j);
+    float impulse_magnitude = -(1.0f + elastic_c) * dv_dot_n * inv_mass_sum;
+    sf::Vector2f impulse = n * impulse_magnitude;
+    ps.add_velocity(p_i, impulse * m_j);
+    ps.add_velocity(p_j, -impulse * m_i);
+    if (penetration > 0.0f)
+    {
+      sf::Vector2f correction =
+          n * (penetration * correction_factor * inv_mass_sum);
+      ps.set_position(p_i, ps.get_position(p_i) + correction * m_j);
+      ps.set_position(p_j, ps.get_position(p_j) - correction * m_i);
+    }
+  }
+#ifdef DEBUG
+  v_i = ps.get_velocity(p_i);
+  v_j = ps.get_velocity(p_j);
+  mom_1 = v_i * m_0 + v_j * m_1;
+  mom_diff = mom_1 - mom_0;
+  float mom_error = std::hypot(mom_diff.x, mom_diff.y);
+  if (mom_error > 0.001)
+  {
+    printf("Momentum changed by: %0.6f\n", mom_error);
+  }
+#endif
+  ps.version[p_i]++;
+  ps.version[p_j]++;
+  if (this->windowed)
+  {
+    d->path.push_back(ps.save(p_i));
+    d->path.push_back(ps.save(p_j));
+  }
+  return COLLISION_TRUE;
 }
 
-collision_status_t ParticleSim::collide(CollisionEvent event)
+collision_status_t ParticleSim::collide(sim_domain_t *d, CollisionEvent event)
 {
-  if (!collision_is_valid(event))
+  if (!collision_is_valid(d, event))
   {
+    d->counters.events_stale++;
     return COLLISION_FALSE;
   }
-  Particle *p_i = event.particle_i;
-  Particle *p_j = event.particle_j;
+  ParticleStore &ps = this->particles;
+  particle_t p_i = event.particle_i;
+  this->touch(p_i);
   float collision_time = event.time;
-  switch (event.type)
+  switch (event.type())
   {
   case CollisionType::EDGE:
   {
 #ifdef DEBUG
     printf("Edge collision\n");
 #endif
-    this->advance_time(collision_time - t_now);
-    p_i->advance(collision_time - p_i->t_current);
-    p_i->add_velocity(event.v_delta);
-    p_i->edge_collision_time = collision_time;
+    this->advance_time(d, collision_time - d->t_now);
+    ps.advance(p_i, collision_time - ps.t_current[p_i]);
+    ps.add_velocity(p_i, this->circular
+                             ? this->circular->edge_v_delta(&ps, p_i)
+                             : this->field->edge_v_delta(&ps, p_i));
+    ps.edge_collision_time[p_i] = collision_time;
     // Correct position if particle is outside boundary
-    sf::Vector2f field_center =
-        sf::Vector2f(PARTICLE_FIELD_CENTER_X, PARTICLE_FIELD_CENTER_Y);
-    sf::Vector2f to_particle = p_i->get_position() - field_center;
+    sf::Vector2f to_particle = ps.get_position(p_i) - this->origin;
     float dist = std::sqrt(to_particle.x * to_particle.x +
                            to_particle.y * to_particle.y);
-    float max_dist = PARTICLE_FIELD_RADIUS - p_i->get_radius();
+    float max_dist = this->config.field_radius - ps.radius[p_i];
     if (dist > max_dist && dist > 0.0f)
     {
-      sf::Vector2f corrected = field_center + to_particle * (max_dist / dist);
-      p_i->set_position(corrected);
+      sf::Vector2f corrected = this->origin + to_particle * (max_dist / dist);
+      ps.set_position(p_i, corrected);
     }
-    p_i->version++;
+    ps.version[p_i]++;
+    if (this->windowed)
+      d->path.push_back(ps.save(p_i));
     return COLLISION_TRUE;
     break;
   }
   case CollisionType::PARTICLE:
-#ifdef DEBUG
-    printf("Particle collision\n");
-#endif
-    this->advance_time(collision_time - t_now);
-    p_i->advance(collision_time - p_i->t_current);
-    p_j->advance(collision_time - p_j->t_current);
-    // resolve elastic collision
-    sf::Vector2f dp = p_i->get_position() - p_j->get_position();
-    float dp_length = std::sqrt(dp.x * dp.x + dp.y * dp.y);
-    sf::Vector2f n = sf::Vector2f(dp.x / dp_length, dp.y / dp_length);
-    sf::Vector2f dv = p_i->get_velocity() - p_j->get_velocity();
-    float dv_dot_n = (dv.x * n.x + dv.y * n.y);
-    if (dv_dot_n >= 0.0f)
-      return COLLISION_FALSE;
-    float m_i = p_i->get_mass();
-    float m_j = p_j->get_mass();
-    float inv_mass_sum = 1.0f / (m_i + m_j);
-    float elastic_c = PARTICLE_ELASTIC_COEFF;
-    float impulse_magnitude = -(1.0f + elastic_c) * dv_dot_n * inv_mass_sum;
-    sf::Vector2f impulse = n * impulse_magnitude;
-#ifdef DEBUG
-    // check for conservation of momentum
-    sf::Vector2f v_i, v_j, mom_0, mom_1, mom_diff;
-    v_i = p_i->get_velocity();
-    v_j = p_j->get_velocity();
-    mom_0 = v_i * p_i->get_mass() + v_j * p_j->get_mass();
-#endif
-    p_i->add_velocity(impulse * m_j);
-    p_j->add_velocity(-impulse * m_i);
-    // After impulse application
-    const float total_r = p_i->get_radius() + p_j->get_radius();
-    const float penetration = total_r - dp_length + 0.001f;
-    if (penetration > 0.0f)
-    {
-      const float correction_factor = 0.8f; // 80% fix per collision
-      sf::Vector2f correction =
-          n * (penetration * correction_factor * inv_mass_sum);
-      p_i->set_position(p_i->get_position() + correction * m_j);
-      p_j->set_position(p_j->get_position() - correction * m_i);
-    }
-#ifdef DEBUG
-    v_i = p_i->get_velocity();
-    v_j = p_j->get_velocity();
-    mom_1 = v_i * p_i->get_mass() + v_j * p_j->get_mass();
-    mom_diff = mom_1 - mom_0;
-    float mom_error = std::hypot(mom_diff.x, mom_diff.y);
-    if (mom_error > 0.001)
+  {
+    Restitution restitution = {this->config.elastic_coeff};
+    switch (this->physics)
     {
-      printf("Momentum changed by: %0.6f\n", mom_error);
+    case PHYSICS_UNIFORM_ELASTIC:
+      return this->collide_particles(
+          d, event, UniformElasticPhysics{this->uniform_radius, Elastic()});
+    case PHYSICS_UNIFORM:
+      return this->collide_particles(
+          d, event, UniformPhysics{this->uniform_radius, restitution});
+    case PHYSICS_ELASTIC:
+      return this->collide_particles(
+          d, event, ElasticPhysics{PerParticleRadius(), Elastic()});
+    default:
+      return this->collide_particles(
+          d, event, GeneralPhysics{PerParticleRadius(), restitution});
     }
-#endif
-    p_i->version++;
-    p_j->version++;
-    return COLLISION_TRUE;
     break;
   }
+  }
   return COLLISION_ERR;
 }
 
 void ParticleSim::redetect_collisions_for_particles(
-    std::vector<Particle *> &affected)
+    sim_domain_t *d, std::vector<particle_t> &affected, particle_t exclude)
 {
-  size_t n_particles = this->particles.size();
-  std::vector<CollisionEvent> new_collisions;
+  ParticleStore &ps = this->particles;
+  std::vector<CollisionEvent> &new_collisions = d->scratch.events;
+  new_collisions.clear();
+  d->counters.redetections++;
 
-  for (Particle *p : affected)
+  for (particle_t p : affected)
   {
-    // Edge collision check
-    this->check_for_edge_collision(p, &new_collisions);
-
-    // Particle-particle collision checks
-    for (size_t i = 0; i < n_particles; i++)
+    sim_domain_t &home = this->domains[this->owner[p]];
+    this->touch(p);
+    // Predict from the present; the previous event no longer applies
+    ps.advance(p, d->t_now - ps.t_current[p]);
+    home.queue.remove(p);
+    // Re-bin at the collision position; the trajectory may also be faster now
+    home.grid.move(p, ps.get_position(p));
+    float speed = ps.get_speed(p);
+    if (this->neighbors_valid)
     {
-      Particle *o = this->particles[i];
-      if (o == p)
-        continue;
-      float t_coll;
-      collision_status_t res = time_of_particle_collision(&t_coll, p, o);
-      if (res == COLLISION_TRUE)
+      // The lists miss no pair as long as every particle stays within half
+      // the reach of its build position (overlap corrections also move it)
+      float dx = ps.x[p] - this->neighbor_x0[p];
+      float dy = ps.y[p] - this->neighbor_y0[p];
+      float drift = std::sqrt(dx * dx + dy * dy) + (1.0f - d->t_now) * speed;
+      if (2.0f * drift > this->neighbor_reach)
       {
-        float t_base =
-            p->t_current > o->t_current ? p->t_current : o->t_current;
-        CollisionEvent event;
-        event.time = t_base + t_coll;
-        event.type = CollisionType::PARTICLE;
-        event.particle_i = p;
-        event.particle_j = o;
-        event.version_i = p->version;
-        event.version_j = o->version;
-        new_collisions.push_back(event);
+        if (this->windowed)
+          d->conflict = true; // redone serially, on the grids
+        else
+          this->neighbors_valid = false;
       }
     }
+    if (speed <= this->v_max)
+      continue;
+    if (this->windowed)
+      d->conflict = true; // other domains' drift bound no longer holds
+    else
+      this->v_max = speed;
+  }
+
+  for (particle_t p : affected)
+  {
+    // Edge collision check
+    this->check_for_edge_collision(p, &new_collisions);
+    d->counters.edge_tests++;
+
+    // Particle-particle collision checks (broad phase through the grid)
+    d->counters.pair_tests += this->check_for_particle_collisions(
+        d, p, false, &d->scratch, &new_collisions);
   }
 
   for (const auto &event : new_collisions)
   {
-    this->collision_queue.push(event);
+    if (event.type() == CollisionType::PARTICLE && event.particle_j == exclude)
+      continue;
+    this->schedule_event(d, event);
 #ifdef DEBUG
     printf("Re-detected collision @ t=%0.3f\n", event.time);
 #endif
   }
 }
 
-p_sim_error_t ParticleSim::process_collisions()
+CollisionQueue *ParticleSim::next_queue(sim_domain_t *d)
 {
-  if (STATE_RUNNING != this->state)
+  if (this->windowed)
+    return d->queue.empty() ? NULL : &d->queue;
+  CollisionQueue *next = NULL;
+  for (sim_domain_t &domain : this->domains)
   {
-    return ERR_INVALID_STATE;
+    if (!domain.queue.empty() &&
+        (NULL == next || next->top() > domain.queue.top()))
+      next = &domain.queue;
   }
+  return next;
+}
+
+p_sim_error_t ParticleSim::process_events(sim_domain_t *d, float t_end)
+{
   CollisionEvent event;
-  while (!this->collision_queue.empty())
+  std::vector<particle_t> &affected = d->scratch.affected;
+  while (!d->conflict)
   {
-    event = this->collision_queue.top();
-    this->collision_queue.pop();
+    CollisionQueue *cq = this->next_queue(d);
+    if (NULL == cq || cq->top().time > t_end)
+      break;
+    event = cq->top();
+    if (this->windowed && event.type() == CollisionType::PARTICLE &&
+        this->owner[event.particle_j] != d->id)
+    {
+      d->conflict = true; // the pair spans two domains
+      break;
+    }
+    this->touch(event.particle_i);
+    cq->pop();
+    d->counters.events_popped++;
 #ifdef DEBUG
     printf("Event: at time %0.3f\n", event.time);
 #endif
-    collision_status_t res = this->collide(event);
+    collision_status_t res = this->collide(d, event);
     if (res == COLLISION_ERR)
     {
 #ifdef DEBUG
@@ -278,44 +637,386 @@ p_sim_error_t ParticleSim::process_collisions()
       return ERR_COLLISION_FAIL;
     }
     // Re-detect collisions for particles that just collided
+    affected.clear();
+    affected.push_back(event.particle_i);
     if (res == COLLISION_TRUE)
     {
-      std::vector<Particle *> affected;
-      affected.push_back(event.particle_i);
-      if (event.type == CollisionType::PARTICLE && event.particle_j != NULL)
+      d->counters.collisions++;
+      if (event.type() == CollisionType::PARTICLE &&
+          event.particle_j != PARTICLE_NONE)
       {
         affected.push_back(event.particle_j);
       }
-      redetect_collisions_for_particles(affected);
+      redetect_collisions_for_particles(d, affected, PARTICLE_NONE);
+    }
+    else
+    {
+      // Stale (or the pair was not approaching): the particle only had this
+      // one event scheduled, so it needs a new one. A pair that touched
+      // without approaching cannot meet again on straight paths.
+      particle_t exclude = PARTICLE_NONE;
+      if (event.type() == CollisionType::PARTICLE &&
+          this->collision_is_valid(d, event))
+        exclude = event.particle_j;
+      // Predict from the event time, however far back the last collision was
+      d->t_now = std::max(d->t_now, event.time);
+      redetect_collisions_for_particles(d, affected, exclude);
     }
   }
-#ifdef DEBUG
-  printf("Done processing collisions\n");
-#endif
   return ERR_OK;
 }
 
-p_sim_error_t ParticleSim::make_tracer(Particle *p)
+p_sim_error_t ParticleSim::partition(uint32_t n_domains, float cell_size)
 {
-  ParticleTracer pt(p, PARTICLE_TRACER);
-  this->tracers.push_back(pt);
+  const ParticleStore &ps = this->particles;
+  size_t n = ps.size();
+  this->domains.resize(n_domains);
+  this->owner.assign(n, 0);
+  // Strip bounds at x quantiles, so strips get about as many particles each
+  std::vector<float> &bounds = this->partition_bounds;
+  bounds.clear();
+  if (n_domains > 1)
+  {
+    std::vector<float> &xs = this->partition_x;
+    xs.assign(ps.x.begin(), ps.x.end());
+    for (uint32_t k = 1; k < n_domains; k++)
+    {
+      auto nth = xs.begin() + (k * n) / n_domains;
+      std::nth_element(xs.begin(), nth, xs.end());
+      bounds.push_back(*nth);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    for (size_t i = 0; i < n; i++)
+      this->owner[i] = (uint32_t)(
+          std::upper_bound(bounds.begin(), bounds.end(), ps.x[i]) -
+          bounds.begin());
+  }
+  for (uint32_t k = 0; k < n_domains; k++)
+  {
+    sim_domain_t &d = this->domains[k];
+    d.id = k;
+    d.x_lo = k > 0 ? bounds[k - 1] : -INFINITY;
+    d.x_hi = k + 1 < n_domains ? bounds[k] : INFINITY;
+    d.owned.clear();
+    d.queue.reset(n,
+                  this->config.calendar_queue ? QUEUE_CALENDAR : QUEUE_HEAP);
+    d.t_now = 0.0f;
+    d.conflict = false;
+  }
+  for (size_t i = 0; i < n; i++)
+    this->domains[this->owner[i]].owned.push_back((particle_t)i);
+  for (sim_domain_t &d : this->domains)
+  {
+    if (d.owned.empty())
+      return this->partition(1, cell_size); // too many particles share an x
+    if (ERR_OK != d.grid.build(ps, cell_size, d.owned))
+      return ERR_FAIL;
+  }
   return ERR_OK;
 }
 
-ParticleSim::ParticleSim(uint32_t n) : n_particles(n)
+void ParticleSim::path_of(particle_t p, std::vector<particle_state_t> *path)
+{
+  path->clear();
+  if (this->touched_in[p] != this->window)
+  {
+    path->push_back(this->particles.save(p)); // straight all window long
+    return;
+  }
+  const sim_domain_t &home = this->domains[this->owner[p]];
+  path->push_back(home.undo[this->undo_slot[p]]);
+  // `path` is sorted by particle, then version (collision order)
+  auto first = std::lower_bound(
+      home.path.begin(), home.path.end(), p,
+      [](const particle_state_t &s, particle_t q) { return s.p < q; });
+  for (auto it = first; it != home.path.end() && it->p == p; it++)
+    path->push_back(*it);
+}
+
+/**
+ * @brief Whether two piecewise straight paths come within `r` of each other
+ * while approaching during [t0, t1] (same rule as the collision kernel,
+ * without the float rounding concerns: callers add some slack to `r`).
+ */
+static bool paths_touch(const std::vector<particle_state_t> &a,
+                        const std::vector<particle_state_t> &b, float r,
+                        float t0, float t1)
+{
+  size_t i = 0;
+  size_t j = 0;
+  float t = t0;
+  while (t < t1)
+  {
+    while (i + 1 < a.size() && a[i + 1].t_current <= t)
+      i++;
+    while (j + 1 < b.size() && b[j + 1].t_current <= t)
+      j++;
+    float t_next = t1;
+    if (i + 1 < a.size())
+      t_next = std::min(t_next, a[i + 1].t_current);
+    if (j + 1 < b.size())
+      t_next = std::min(t_next, b[j + 1].t_current);
+    const particle_state_t &sa = a[i];
+    const particle_state_t &sb = b[j];
+    float dx = (sa.x + sa.vx * (t - sa.t_current)) -
+               (sb.x + sb.vx * (t - sb.t_current));
+    float dy = (sa.y + sa.vy * (t - sa.t_current)) -
+               (sb.y + sb.vy * (t - sb.t_current));
+    float dvx = sa.vx - sb.vx;
+    float dvy = sa.vy - sb.vy;
+    float c = dx * dx + dy * dy - r * r;
+    float half_b = dx * dvx + dy * dvy;
+    float a2 = dvx * dvx + dvy * dvy;
+    if (half_b < 0.0f)
+    {
+      if (c <= 0.0f)
+        return true;
+      float disc = half_b * half_b - a2 * c;
+      if (disc >= 0.0f && (-half_b - std::sqrt(disc)) <= a2 * (t_next - t))
+        return true;
+    }
+    t = t_next;
+  }
+  return false;
+}
+
+bool ParticleSim::leak_conflicts(particle_t p, float t0, float t1,
+                                 std::vector<particle_state_t> *path,
+                                 std::vector<particle_state_t> *other_path)
+{
+  const ParticleStore &ps = this->particles;
+  this->path_of(p, path);
+  // Bounding box of the path over the window
+  sf::Vector2f lo(INFINITY, INFINITY);
+  sf::Vector2f hi(-INFINITY, -INFINITY);
+  for (size_t k = 0; k < path->size(); k++)
+  {
+    const particle_state_t &s = (*path)[k];
+    float ta = std::max(t0, s.t_current);
+    float tb = k + 1 < path->size() ? (*path)[k + 1].t_current : t1;
+    float ts[2] = {ta, std::max(ta, tb)};
+    for (float t : ts)
+    {
+      float x = s.x + s.vx * (t - s.t_current);
+      float y = s.y + s.vy * (t - s.t_current);
+      lo = sf::Vector2f(std::min(lo.x, x), std::min(lo.y, y));
+      hi = sf::Vector2f(std::max(hi.x, x), std::max(hi.y, y));
+    }
+  }
+  // As in candidate_box(): binned particles stay within v_max of their bin
+  float pad = ps.radius[p] + this->r_max + this->v_max;
+  lo -= sf::Vector2f(pad, pad);
+  hi += sf::Vector2f(pad, pad);
+  std::vector<uint32_t> &candidates = this->window_candidates;
+  for (const sim_domain_t &other : this->domains)
+  {
+    if (other.id == this->owner[p])
+      continue;
+    candidates.clear();
+    other.grid.query(lo, hi, &candidates);
+    for (particle_t o : candidates)
+    {
+      this->path_of(o, other_path);
+      float r = (ps.radius[p] + ps.radius[o]) * (1.0f + WINDOW_CONTACT_SLACK);
+      if (paths_touch(*path, *other_path, r, t0, t1))
+        return true;
+    }
+  }
+  return false;
+}
+
+p_sim_error_t ParticleSim::process_windows()
+{
+  uint32_t n_domains = (uint32_t)this->domains.size();
+  std::vector<p_sim_error_t> &results = this->window_results;
+  results.assign(n_domains, ERR_OK);
+  float length = 1.0f / PARALLEL_EVENT_WINDOWS;
+  float t0 = 0.0f;
+  uint32_t n_windows = 0;
+  uint32_t n_rollbacks = 0;
+  bool give_up = false; // windows keep failing, see PARALLEL_EVENT_BACKOFF_MAX
+  while (t0 < 1.0f && !give_up)
+  {
+    float t1 = std::min(1.0f, t0 + length);
+    this->window++;
+    for (sim_domain_t &d : this->domains)
+    {
+      add_counters(&this->counters, &d.counters);
+      d.t_now = t0;
+      d.conflict = false;
+      d.undo.clear();
+      d.undo_event.clear();
+      d.path.clear();
+      d.leaked.clear();
+    }
+
+    // Every domain runs the window on its own
+    this->windowed = true;
+    _Pragma("omp parallel for schedule(static, 1)") for (uint32_t k = 0;
+                                                         k < n_domains; k++)
+    {
+      results[k] = this->process_events(&this->domains[k], t1);
+    }
+    this->windowed = false;
+
+    bool conflict = false;
+    for (uint32_t k = 0; k < n_domains; k++)
+    {
+      if (ERR_OK != results[k])
+        return results[k];
+      conflict = conflict || this->domains[k].conflict;
+    }
+    if (!conflict)
+    {
+      std::vector<particle_state_t> &path = this->window_path[0];
+      std::vector<particle_state_t> &other_path = this->window_path[1];
+      // By particle, then in collision order: every collision bumps the
+      // version (std::sort, unlike std::stable_sort, does not allocate)
+      for (sim_domain_t &d : this->domains)
+        std::sort(d.path.begin(), d.path.end(),
+                  [](const particle_state_t &a, const particle_state_t &b) {
+                    return a.p < b.p || (a.p == b.p && a.version < b.version);
+                  });
+      for (const sim_domain_t &d : this->domains)
+      {
+        for (size_t k = 0; k < d.leaked.size() && !conflict; k++)
+          conflict = this->leak_conflicts(d.leaked[k], t0, t1, &path,
+                                          &other_path);
+      }
+    }
+
+    sim_domain_t *serial = &this->domains[0];
+    if (conflict)
+    {
+      // Roll every domain back to the window start, then redo it serially
+      for (sim_domain_t &d : this->domains)
+      {
+        for (size_t k = 0; k < d.undo.size(); k++)
+        {
+          particle_t p = d.undo[k].p;
+          this->particles.restore(d.undo[k]);
+          d.grid.move(p, this->particles.get_position(p));
+          if (d.undo_event[k].particle_i == PARTICLE_NONE)
+            d.queue.remove(p);
+          else
+            d.queue.update(d.undo_event[k]);
+        }
+      }
+      for (sim_domain_t &d : this->domains)
+      {
+        d.conflict = false;
+        d.counters = sim_counters_t(); // only count the work that stays
+      }
+      serial->t_now = t0;
+      p_sim_error_t res = this->process_events(serial, t1);
+      if (ERR_OK != res)
+        return res;
+      this->counters.rollbacks++;
+      n_rollbacks++;
+      // Even the shortest windows fail
+      give_up = length <= 1.0f / PARALLEL_EVENT_WINDOWS_MAX;
+      length = std::max(length * 0.5f, 1.0f / PARALLEL_EVENT_WINDOWS_MAX);
+    }
+    else
+    {
+      // Leaked particles were predicted without the other domains' particles
+      serial->t_now = t1;
+      std::vector<particle_t> &affected = serial->scratch.affected;
+      affected.clear();
+      for (const sim_domain_t &d : this->domains)
+        affected.insert(affected.end(), d.leaked.begin(), d.leaked.end());
+      this->redetect_collisions_for_particles(serial, affected, PARTICLE_NONE);
+      // Grows slower than it shrinks: settles near one rollback in four
+      length = std::min(length * 1.25f, 1.0f / PARALLEL_EVENT_WINDOWS);
+    }
+    n_windows++;
+    this->counters.windows++;
+    t0 = t1;
+    // Most windows get redone anyway
+    if (n_windows >= PARALLEL_EVENT_WINDOWS && 2 * n_rollbacks > n_windows)
+      give_up = true;
+  }
+  if (!give_up)
+  {
+    this->serial_backoff = 1;
+    return ERR_OK;
+  }
+
+  // Windows keep failing: the rest of this timestep (across every domain),
+  // and the next serial_backoff timesteps (with a single domain), go serial
+  this->serial_left = this->serial_backoff;
+  this->serial_backoff =
+      std::min<uint32_t>(2 * this->serial_backoff, PARALLEL_EVENT_BACKOFF_MAX);
+  if (t0 >= 1.0f)
+    return ERR_OK;
+  sim_domain_t *serial = &this->domains[0];
+  serial->t_now = t0;
+  return this->process_events(serial, 1.0f);
+}
+
+p_sim_error_t ParticleSim::process_collisions()
+{
+  if (STATE_RUNNING != this->state)
+  {
+    return ERR_INVALID_STATE;
+  }
+  p_sim_error_t res;
+  if (this->domains.size() > 1)
+    res = this->process_windows();
+  else
+    res = this->process_events(&this->domains[0], 1.0f);
+#ifdef DEBUG
+  printf("Done processing collisions\n");
+#endif
+  return res;
+}
+
+ParticleSim::ParticleSim(const SimConfig &config)
+    : config(config), n_particles(config.n_particles)
+#ifndef HEADLESS
+      ,
+      tracer(config)
+#endif
 {
   this->state = STATE_INIT;
-  this->origin = sf::Vector2f(PARTICLE_FIELD_CENTER_X, PARTICLE_FIELD_CENTER_Y);
+  this->clear_stats();
+  this->windowed = false;
+  this->window = 0;
+  this->serial_left = 0;
+  this->serial_backoff = 1;
+  this->physics = PHYSICS_GENERAL;
+  this->uniform_radius = UniformRadius();
+  this->timestep = 0;
+  this->timestep_begin = 0;
+  this->t_now = 0.0f;
+  this->r_max = 0.0f;
+  this->v_max = 0.0f;
+  this->neighbor_reach = -1.0f;
+  this->neighbors_valid = false;
+  this->origin = sf::Vector2f(config.field_center_x, config.field_center_y);
   this->field = NULL;
+  this->circular = NULL;
+  this->trajectory = NULL;
+#ifndef HEADLESS
+  this->front = 0;
+  this->snapshot_ready = false;
+  this->capture_skip = false;
+#endif
 }
 
-ParticleSim::ParticleSim(uint32_t n, ParticleField *field)
-    : n_particles(n), field(field)
+ParticleSim::ParticleSim(uint32_t n) : ParticleSim(SimConfig())
+{
+  this->config.n_particles = n;
+  this->n_particles = n;
+}
+
+ParticleSim::ParticleSim(uint32_t n, ParticleField *field) : ParticleSim(n)
 {
-  this->state = STATE_READY;
-  this->origin = sf::Vector2f(PARTICLE_FIELD_CENTER_X, PARTICLE_FIELD_CENTER_Y);
   if (field == NULL)
     throw std::runtime_error("field is NULL!");
+  this->field = field;
+  this->circular = dynamic_cast<ParticleFieldCircular *>(field);
+  this->state = STATE_READY;
 }
 
 p_sim_error_t ParticleSim::assign_field(ParticleField *field)
@@ -325,84 +1026,227 @@ p_sim_error_t ParticleSim::assign_field(ParticleField *field)
   if (this->state != STATE_INIT || this->field != NULL)
     return ERR_INVALID_STATE;
   this->field = field;
+  this->circular = dynamic_cast<ParticleFieldCircular *>(field);
   this->state = STATE_READY;
   return ERR_OK;
 }
 
+void ParticleSim::assign_trajectory(TrajectoryWriter *writer)
+{
+  this->trajectory = writer;
+}
+
+void ParticleSim::select_physics()
+{
+  // Constant contact distance and even impulses if every particle is the
+  // same, no restitution coefficient if elastic
+  const ParticleStore &ps = this->particles;
+  this->physics = PHYSICS_GENERAL;
+  if (!this->config.specialize)
+    return;
+  bool uniform = true;
+  for (size_t i = 1; uniform && i < ps.size(); i++)
+    uniform = ps.radius[i] == ps.radius[0] && ps.mass[i] == ps.mass[0];
+  if (uniform)
+  {
+    this->physics |= PHYSICS_UNIFORM;
+    this->uniform_radius.R = ps.radius[0] + ps.radius[0];
+    this->uniform_radius.R_sq = this->uniform_radius.R * this->uniform_radius.R;
+  }
+  if (this->config.is_elastic())
+    this->physics |= PHYSICS_ELASTIC;
+}
+
 p_sim_error_t ParticleSim::begin()
 {
   if (this->field == NULL)
     return ERR_NULL_PTR;
   if (this->state != STATE_READY)
     return ERR_INVALID_STATE;
-  if (ERR_OK != this->field->init(&this->particles, this->n_particles))
+  this->rng.seed(this->config.seed);
+  if (ERR_OK !=
+      this->field->init(&this->particles, this->n_particles, &this->rng))
     return ERR_FAIL;
+  this->select_physics();
+  this->neighbor_reach = -1.0f; // new particles
   this->t_now = 0.0;
+  this->timestep = 0;
+  this->timestep_begin = this->timestep;
+  this->clear_stats();
+#ifndef HEADLESS
+  this->snapshots[this->front].capture(
+      &this->particles, this->config.speed_colors, this->timestep);
+#endif
   this->state = STATE_RUNNING;
   return ERR_OK;
 }
 
+p_sim_error_t ParticleSim::restore(const char *path)
+{
+  if (this->field == NULL)
+    return ERR_NULL_PTR;
+  if (this->state != STATE_READY)
+    return ERR_INVALID_STATE;
+  checkpoint_header_t header;
+  p_sim_error_t res = Checkpoint::read(path, &header, &this->particles);
+  if (ERR_OK != res)
+    return res;
+  if (header.field_center_x != this->config.field_center_x ||
+      header.field_center_y != this->config.field_center_y ||
+      header.field_radius != this->config.field_radius)
+  {
+    this->particles.clear();
+    return ERR_INVALID_STATE;
+  }
+  this->n_particles = header.n_particles;
+  this->rng.state = header.rng_state;
+  this->rng.inc = header.rng_inc;
+  this->select_physics();
+  this->neighbor_reach = -1.0f; // new particles
+  this->t_now = 0.0;
+  this->timestep = header.timestep;
+  this->timestep_begin = this->timestep;
+  this->clear_stats();
+#ifndef HEADLESS
+  this->snapshots[this->front].capture(
+      &this->particles, this->config.speed_colors, this->timestep);
+#endif
+  this->state = STATE_RUNNING;
+  return ERR_OK;
+}
+
+p_sim_error_t ParticleSim::save_checkpoint(const char *path)
+{
+  if (this->state != STATE_RUNNING)
+    return ERR_INVALID_STATE;
+  checkpoint_header_t header = checkpoint_header_t();
+  header.timestep = this->timestep;
+  header.rng_state = this->rng.state;
+  header.rng_inc = this->rng.inc;
+  header.field_center_x = this->config.field_center_x;
+  header.field_center_y = this->config.field_center_y;
+  header.field_radius = this->config.field_radius;
+  return Checkpoint::write(path, header, &this->particles);
+}
+
 p_sim_error_t ParticleSim::update()
 {
   if (this->state != STATE_RUNNING)
     return ERR_INVALID_STATE;
   this->t_now = 0.0;
+  std::chrono::steady_clock::time_point t_phase =
+      std::chrono::steady_clock::now();
 
   size_t n = this->particles.size();
 
   // Reset all particles
+  ParticleStore &ps = this->particles;
+  float max_radius = 0.0f;
+  float max_speed = 0.0f;
+  float max_drift = 0.0f; // from the neighbor list build, by t = 1
+  bool listed = this->neighbor_reach >= 0.0f && this->neighbor_x0.size() == n;
+  _Pragma("omp parallel for reduction(max : max_radius, max_speed, max_drift)")
+      for (size_t i = 0; i < n; i++)
+  {
+    ps.reset(i);
+    max_radius = std::max(max_radius, ps.radius[i]);
+    float speed = ps.get_speed(i);
+    max_speed = std::max(max_speed, speed);
+    if (listed)
+    {
+      float dx = ps.x[i] - this->neighbor_x0[i];
+      float dy = ps.y[i] - this->neighbor_y0[i];
+      max_drift = std::max(max_drift, std::sqrt(dx * dx + dy * dy) + speed);
+    }
+  }
+  this->r_max = max_radius;
+  this->v_max = max_speed;
+  t_phase = lap(&this->phase_time.reset, t_phase);
 
-  _Pragma("omp parallel for") for (size_t i = 0; i < n; i++)
+  // One domain per thread, if each gets enough particles to be worth it
+  uint32_t n_domains = 1;
+#ifdef USE_OPENMP
+  if (this->serial_left > 0)
+    this->serial_left--; // backing off after windows failed
+  else if (PARALLEL_EVENT_WINDOWS > 0)
+    n_domains = (uint32_t)std::max<size_t>(
+        1, std::min<size_t>((size_t)omp_get_max_threads(),
+                            n / PARALLEL_EVENT_MIN_PARTICLES));
+#endif
+  if (this->touched_in.size() != n)
   {
-    this->particles[i]->version = 0;
-    this->particles[i]->t_current = 0.0f;
+    this->touched_in.assign(n, 0);
+    this->undo_slot.assign(n, 0);
+    this->leaked_in.assign(n, 0);
   }
 
-  // Check for edge collisions
-  _Pragma("omp parallel")
+  // Broad phase: cells span a particle pair plus a timestep of travel each
+  float cell_size = 2.0f * max_radius + 2.0f * max_speed;
+  if (ERR_OK != this->partition(n_domains, cell_size))
+    return ERR_FAIL;
+  sim_domain_t *serial = &this->domains[0];
+  uint32_t n_threads = 1;
+#ifdef USE_OPENMP
+  n_threads = (uint32_t)omp_get_max_threads();
+#endif
+  this->detected.resize(n_threads);
+  this->thread_scratch.resize(n_threads);
+
+  // Neighbor lists: rebuilt once a particle may get more than half the reach
+  // away from its build position this timestep
+  this->neighbors_valid = false;
+  if (this->config.neighbor_lists)
   {
-    std::vector<CollisionEvent> local_collisions;
-    _Pragma("omp for schedule(dynamic)") for (size_t i = 0; i < n; i++)
+    if (!listed || 2.0f * max_drift > this->neighbor_reach)
     {
-      // Edge Collisions
-      Particle *p = this->particles[i];
-      this->check_for_edge_collision(p, &local_collisions);
+      this->build_neighbors(2.0f * max_speed + this->config.neighbor_skin);
+      this->counters.neighbor_builds++;
+    }
+    this->neighbors_valid = true;
+  }
 
-      // Particle-to-Particle Collisions
-      for (size_t j = 0; j < i; j++)
-      {
-        Particle *o = this->particles[j];
-        float t_coll;
-        collision_status_t res = time_of_particle_collision(&t_coll, p, o);
-        if (res == COLLISION_TRUE)
-        {
-          float t_base =
-              p->t_current > o->t_current ? p->t_current : o->t_current;
-          CollisionEvent event;
-          event.time = t_base + t_coll;
-          event.type = CollisionType::PARTICLE;
-          event.particle_i = p;
-          event.particle_j = o;
-          event.version_i = p->version;
-          event.version_j = o->version;
-          local_collisions.push_back(event);
-        }
-      }
+  // Check for edge collisions
+  uint64_t pair_tests = 0;
+  uint64_t edge_tests = 0;
+  _Pragma("omp parallel reduction(+ : pair_tests, edge_tests)")
+  {
+    uint32_t thread = 0;
+#ifdef USE_OPENMP
+    thread = (uint32_t)omp_get_thread_num();
+#endif
+    std::vector<CollisionEvent> &local_collisions = this->detected[thread];
+    detect_scratch_t &local_scratch = this->thread_scratch[thread];
+    local_collisions.clear();
+    // Edge Collisions, a batch of consecutive particles at a time
+    _Pragma("omp for schedule(static) nowait") for (size_t i = 0; i < n;
+                                                    i += EDGE_BATCH)
+    {
+      size_t end = std::min<size_t>(n, i + EDGE_BATCH);
+      this->check_for_edge_collisions((particle_t)i, (particle_t)end,
+                                      &local_collisions);
+      edge_tests += end - i;
     }
-    // register collisions
-    _Pragma("omp critical") for (const auto &event : local_collisions)
+    _Pragma("omp for schedule(dynamic)") for (size_t i = 0; i < n; i++)
     {
-      this->collision_queue.push(event);
-#ifdef DEBUG
-      printf("Collisions: %lu\n", this->collision_queue.size());
-#endif
+      particle_t p = (particle_t)i;
+
+      // Particle-to-Particle Collisions (each pair once, j < i)
+      pair_tests += this->check_for_particle_collisions(
+          serial, p, true, &local_scratch, &local_collisions);
     }
-    // for (CollisionEvent event : local_collisions)
-    //{
-    //   this->collision_queue.register_particle_collision(
-    //       event.time, event.particle_i, event.particle_j);
-    // }
   }
+  this->counters.pair_tests += pair_tests;
+  this->counters.edge_tests += edge_tests;
+
+  // Register collisions: every domain takes its own particles' events from
+  // all the threads' buffers, so no two threads touch the same queue
+  n_domains = (uint32_t)this->domains.size();
+  _Pragma("omp parallel for schedule(static, 1)") for (uint32_t k = 0;
+                                                       k < n_domains; k++)
+  {
+    this->seed_queue(&this->domains[k]);
+  }
+  t_phase = lap(&this->phase_time.detection, t_phase);
 
   // Process collisions
   p_sim_error_t res = this->process_collisions();
@@ -411,56 +1255,161 @@ p_sim_error_t ParticleSim::update()
     return res;
   }
 
+  for (sim_domain_t &d : this->domains)
+    add_counters(&this->counters, &d.counters);
+  t_phase = lap(&this->phase_time.events, t_phase);
+
   // Continue flying
-  _Pragma("omp parallel for") for (size_t i = 0; i < this->particles.size();
-                                   i++)
+  _Pragma("omp parallel for") for (size_t i = 0; i < n; i++)
   {
-    Particle *p = this->particles[i];
-    p->advance(1.0f - p->t_current);
+    ps.advance(i, 1.0f - ps.t_current[i]);
   }
-  this->advance_time(1.0 -
-                     this->t_now); // not strictly necessary, but "correct"
+  lap(&this->phase_time.flight, t_phase);
+  this->t_now = 1.0f; // not strictly necessary, but "correct"
+  this->timestep++;
+  if (this->trajectory)
+  {
+    res = this->trajectory->record(&this->particles, this->timestep);
+    if (ERR_OK != res)
+      return res;
+  }
+#ifndef HEADLESS
+  // For the renderer, which may be drawing the front snapshot meanwhile
+  if (!this->capture_skip)
+  {
+    this->snapshots[1 - this->front].capture(&ps, this->config.speed_colors,
+                                             this->timestep);
+    this->snapshot_ready = true;
+  }
+#endif
+  if (this->config.stats_every > 0 &&
+      0 == (this->timestep - this->timestep_begin) % this->config.stats_every)
+    this->print_stats(stderr);
 #ifdef DEBUG
   float v_max;
   float v_sum = 0.0f;
   float kinetic_energy = 0.0f;
-  for (Particle *p : this->particles)
+  for (size_t i = 0; i < n; i++)
   {
-    sf::Vector2f v = p->get_velocity();
+    sf::Vector2f v = ps.get_velocity(i);
     float v_sq = v.x * v.x + v.y * v.y;
     float v_mag = std::sqrt(v_sq);
     v_max = v_mag > v_max ? v_mag : v_max;
     v_sum += v_mag;
-    kinetic_energy += 0.5f * p->get_mass() * v_sq;
+    kinetic_energy += 0.5f * ps.mass[i] * v_sq;
   }
   printf("v_max: %0.3f\n", v_max);
-  printf("v_avg: %0.3f\n", v_sum / (float)PARTICLE_QUANTITY);
+  printf("v_avg: %0.3f\n", v_sum / (float)n);
   printf("total kinetic energy: %0.3f\n", kinetic_energy);
 #endif
   return ERR_OK;
 }
 
-p_sim_error_t ParticleSim::render(sf::RenderWindow *window)
+p_sim_error_t ParticleSim::step(uint32_t n_steps)
 {
-  for (Particle *p : this->particles)
+  p_sim_error_t res = ERR_OK;
+  for (uint32_t i = 0; i < n_steps && ERR_OK == res; i++)
   {
-    p->render(window);
-    this->make_tracer(p);
+#ifndef HEADLESS
+    // Frames only ever show the last timestep
+    this->capture_skip = i + 1 < n_steps;
+#endif
+    res = this->update();
   }
-#ifdef DEBUG
-  printf("tracers: %ld\n", this->tracers.size());
+#ifndef HEADLESS
+  this->capture_skip = false;
 #endif
-  for (size_t i = 0; i < this->tracers.size(); i++)
+  return res;
+}
+
+sim_counters_t ParticleSim::get_counters() { return this->counters; }
+
+void ParticleSim::clear_stats()
+{
+  this->counters = sim_counters_t();
+  this->phase_time = sim_phase_times_t();
+  this->render_ns = 0;
+  this->frames = 0;
+}
+
+sim_stats_t ParticleSim::get_stats()
+{
+  sim_stats_t stats;
+  stats.timesteps = this->timestep - this->timestep_begin;
+  stats.frames = this->frames;
+  stats.counters = this->counters;
+  stats.time = this->phase_time;
+  stats.time.render = (double)this->render_ns * 1e-9;
+  return stats;
+}
+
+void ParticleSim::print_stats(FILE *out)
+{
+  sim_stats_t s = this->get_stats();
+  const sim_counters_t &c = s.counters;
+  double per_step = s.timesteps ? 1e3 / s.timesteps : 0.0;
+  double per_frame = s.frames ? 1e3 / s.frames : 0.0;
+  fprintf(out,
+          "stats: timesteps %lu frames %lu | pair_tests %lu edge_tests %lu "
+          "pushed %lu popped %lu stale %lu queue_max %lu collisions %lu "
+          "redetections %lu neighbor_builds %lu windows %lu rollbacks %lu | "
+          "ms/step reset %.3f "
+          "detection %.3f events %.3f flight %.3f | ms/frame render %.3f\n",
+          (unsigned long)s.timesteps, (unsigned long)s.frames,
+          (unsigned long)c.pair_tests, (unsigned long)c.edge_tests,
+          (unsigned long)c.events_pushed, (unsigned long)c.events_popped,
+          (unsigned long)c.events_stale, (unsigned long)c.queue_depth_max,
+          (unsigned long)c.collisions, (unsigned long)c.redetections,
+          (unsigned long)c.neighbor_builds, (unsigned long)c.windows,
+          (unsigned long)c.rollbacks,
+          s.time.reset * per_step, s.time.detection * per_step,
+          s.time.events * per_step, s.time.flight * per_step,
+          s.time.render * per_frame);
+}
+
+uint64_t ParticleSim::get_timestep() { return this->timestep; }
+
+#ifndef HEADLESS
+void ParticleSim::publish()
+{
+  if (!this->snapshot_ready)
+    return;
+  this->front = 1 - this->front;
+  this->snapshot_ready = false;
+}
+
+p_sim_error_t ParticleSim::render(sf::RenderWindow *window)
+{
+  if (NULL == window)
+    return ERR_NULL_PTR;
+  std::chrono::steady_clock::time_point t_start =
+      std::chrono::steady_clock::now();
+  const RenderSnapshot &snapshot = this->snapshots[this->front];
+  // Pixels per world unit, so circle detail follows the on-screen size
+  float pixel_scale =
+      (float)window->getSize().x / window->getView().getSize().x;
+  this->disc_batch.clear();
+  // Trails first, so particles are drawn over them
+  this->tracer.render(&snapshot, &this->disc_batch, pixel_scale);
+  for (particle_t p = 0; p < snapshot.size(); p++)
   {
-    ParticleTracer *pt = &this->tracers.at(i);
-    if (!pt->render(window))
-    {
-      this->tracers.erase(tracers.begin() + i);
-    }
+    if (PARTICLE_DISABLE_DISAPPEAR && !snapshot.enabled[p])
+      continue;
+    this->disc_batch.add(snapshot.position[p], snapshot.radius[p],
+                         pixel_scale, snapshot.color[p]);
   }
+  this->tracer.record(&snapshot);
+  if (ERR_OK != this->disc_batch.draw(window))
+    return ERR_FAIL;
   if (ERR_OK != this->field->render(window))
   {
     return ERR_FAIL;
   }
+  this->render_ns += (uint64_t)std::chrono::duration_cast<
+                         std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - t_start)
+                         .count();
+  this->frames++;
   return ERR_OK;
 }
+#endif
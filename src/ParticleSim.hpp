@@ -1,17 +1,117 @@
 #ifndef __PARTICLESIM_HPP__
 #define __PARTICLESIM_HPP__
 
-#include <SFML/Graphics.hpp>
-#include <queue>
+#ifndef HEADLESS
+  #include <SFML/Graphics.hpp>
+#endif
+#include <atomic>
 #include <stdint.h>
+#include <stdio.h>
 
+#include "Checkpoint.hpp"
 #include "CollisionEvent.hpp"
-#include "Particle.hpp"
+#include "CollisionKernel.hpp"
+#include "CollisionQueue.hpp"
+#include "DiscBatch.hpp"
+#include "ParticleStore.hpp"
 #include "ParticleField.hpp"
+#include "ParticleFieldCircular.hpp"
 #include "ParticleTracer.hpp"
+#include "PhysicsPolicy.hpp"
+#include "RenderSnapshot.hpp"
+#include "SimConfig.hpp"
+#include "SimRandom.hpp"
+#include "SpatialGrid.hpp"
+#include "TrajectoryWriter.hpp"
 #include "config.h"
 #include "p_sim_error.h"
 
+/**
+ * @brief Running totals of the work done by the sim since begin().
+ *
+ * Every domain (and every detection thread) counts into its own copy, which
+ * is added to the sim's totals between phases, so counting needs no atomics.
+ */
+typedef struct
+{
+  uint64_t pair_tests;    // particle-particle time of collision tests
+  uint64_t edge_tests;    // particle-edge time of collision tests
+  uint64_t events_pushed; // events scheduled (inserted or moved earlier)
+  uint64_t events_popped; // events popped from the collision queue
+  uint64_t events_stale;  // popped events discarded by collision_is_valid()
+  uint64_t collisions;    // collisions applied
+  uint64_t redetections;  // redetect_collisions_for_particles() calls
+  uint64_t neighbor_builds; // neighbor list (re)builds
+  uint64_t queue_depth_max; // most events queued at once in one domain
+  uint64_t windows;       // parallel event windows (0 when serial)
+  uint64_t rollbacks;     // parallel windows redone serially
+} sim_counters_t;
+
+/**
+ * @brief Time spent in each phase of the sim, in seconds.
+ */
+typedef struct
+{
+  double reset;     // per-timestep bookkeeping reset
+  double detection; // broad phase and initial event detection
+  double events;    // event processing (collisions and re-detection)
+  double flight;    // free flight to the end of the timestep
+  double render;    // render() (windowed builds)
+} sim_phase_times_t;
+
+/**
+ * @brief Performance statistics since begin() (or restore()).
+ */
+typedef struct
+{
+  uint64_t timesteps; // update() calls
+  uint64_t frames;    // render() calls
+  sim_counters_t counters;
+  sim_phase_times_t time;
+} sim_stats_t;
+
+/**
+ * @brief Scratch buffers for collision detection (one per thread, and one
+ * per domain for re-detection). Kept across timesteps, so that detection
+ * stops allocating once they have grown to size.
+ */
+typedef struct
+{
+  std::vector<uint32_t> candidates;    // grid query results
+  std::vector<uint32_t> hit_particles; // candidates hit by the batch kernel
+  std::vector<float> hit_times;        // and their collision times
+  std::vector<particle_t> affected;    // particles to re-detect
+  std::vector<CollisionEvent> events;  // re-detected events
+  std::vector<particle_t> neighbors;   // neighbor lists built by the thread
+} detect_scratch_t;
+
+/**
+ * @brief Event processing state of one spatial domain.
+ *
+ * The field is cut into vertical strips, one domain each (a single domain
+ * when serial). A domain owns the particles that start the timestep in its
+ * strip: only those are binned in its grid and have their events in its
+ * queue. See `process_windows()`.
+ */
+typedef struct
+{
+  uint32_t id;
+  float x_lo;                    // strip bounds (x_lo <= x < x_hi at t = 0)
+  float x_hi;
+  std::vector<particle_t> owned; // particles of this domain
+  CollisionQueue queue;          // earliest event of each owned particle
+  SpatialGrid grid;              // broad phase over the owned particles
+  detect_scratch_t scratch;      // detection buffers
+  float t_now;                   // time of the last event processed
+  sim_counters_t counters;
+  // Parallel window bookkeeping
+  bool conflict; // the window needs a particle of another domain
+  std::vector<particle_state_t> undo;     // touched particles, window start
+  std::vector<CollisionEvent> undo_event; // and their events (or none)
+  std::vector<particle_state_t> path;     // states after each collision
+  std::vector<particle_t> leaked; // predicted while near another domain
+} sim_domain_t;
+
 /**
  * @brief Particle simulation logic class. Handles collisions and timestep
  * increment.
@@ -19,55 +119,188 @@
 class ParticleSim
 {
 private:
+  SimConfig config;
   uint32_t n_particles;
   ParticleField *field;
-  std::vector<Particle *> particles;
-  std::vector<ParticleTracer> tracers;
-  priority_queue<CollisionEvent> collision_queue;
+  // The field if it is a ParticleFieldCircular (else NULL): its edge math is
+  // called through this pointer, inlined instead of dispatched virtually.
+  ParticleFieldCircular *circular;
+  TrajectoryWriter *trajectory; // optional, records after every timestep
+  ParticleStore particles;
+#ifndef HEADLESS
+  ParticleTracer tracer; // trails of past positions
+  DiscBatch disc_batch;  // particles + trails, drawn in one call
+  RenderSnapshot snapshots[2]; // drawn (front) and being captured (back)
+  uint32_t front;              // index of the front snapshot
+  bool snapshot_ready;         // back holds a capture not yet published
+  bool capture_skip;           // update() takes no snapshot (inside step())
+#endif
+  std::vector<sim_domain_t> domains; // one per strip
+  std::vector<uint32_t> owner;       // domain of each particle
+  // events found by each thread at the start of the timestep
+  std::vector<std::vector<CollisionEvent>> detected;
+  std::vector<detect_scratch_t> thread_scratch; // and its detection buffers
+  // Scratch of partition() and process_windows(), reused every timestep
+  std::vector<float> partition_x;
+  std::vector<float> partition_bounds;
+  std::vector<p_sim_error_t> window_results;
+  std::vector<particle_state_t> window_path[2];
+  std::vector<uint32_t> window_candidates;
+  bool windowed;  // domains are processing a window in parallel
+  uint32_t window; // current window, stamps the bookkeeping below
+  uint32_t serial_left;    // timesteps left to run serially (windows failed)
+  uint32_t serial_backoff; // serial timesteps after the next failure
+  std::vector<uint32_t> touched_in; // last window a particle was saved in
+  std::vector<uint32_t> undo_slot;  // and its entry in its domain's undo
+  std::vector<uint32_t> leaked_in;  // last window a particle leaked in
+  physics_t physics;                // pair physics specialization
+  UniformRadius uniform_radius;     // contact distance, PHYSICS_UNIFORM
+  float r_max;                      // largest particle radius
+  float v_max; // largest particle speed seen so far this timestep
+  // Verlet neighbor lists (CSR), see build_neighbors()
+  std::vector<uint32_t> neighbor_start; // first entry of each particle, n + 1
+  std::vector<particle_t> neighbors;
+  std::vector<float> neighbor_x0; // positions when the lists were built
+  std::vector<float> neighbor_y0;
+  float neighbor_reach; // list distance beyond the radii (< 0: not built)
+  bool neighbors_valid; // lists hold every pair that can collide this step
   sf::Vector2f origin;
   sim_state_t state;
   float t_now;
+  uint64_t timestep; // timesteps run (carried over by checkpoints)
+  uint64_t timestep_begin; // timestep at begin() or restore()
+  SimRandom rng;     // particle generation
+  sim_counters_t counters;
+  sim_phase_times_t phase_time; // update() phases (render is below)
+  // Written by render(), possibly while update() runs on another thread
+  std::atomic<uint64_t> render_ns;
+  std::atomic<uint64_t> frames;
 
   /**
    * @brief Checks validity of collision events against simulation state.
+   * @param d domain processing the event
    * @param event collision event
    */
-  bool collision_is_valid(CollisionEvent event);
+  bool collision_is_valid(sim_domain_t *d, CollisionEvent event);
 
   /**
-   * @brief Advances time (t_now) by specified delta
+   * @brief Advances a domain's time (t_now) by specified delta
+   * @param d domain
    * @param t_delta the amount of time to advance (t_now + t_delta <= 1.0)
    * @return ERR_OK if successful
    */
-  p_sim_error_t advance_time(float t_delta);
+  p_sim_error_t advance_time(sim_domain_t *d, float t_delta);
 
   /**
    * @brief helper function to find time of collision (if any) between 2
-   * particles)
+   * particles) (scalar, see `CollisionKernel::time_of()`)
+   * @param d domain (for its t_now)
    * @param t_coll address of where to write collision time
    * @param p_i the first particle
    * @param p_j the second particle
    * @return COLLISION_TRUE if collided (collision time at *t_coll),
    * COLLISION_FALSE if not
    */
-  collision_status_t time_of_particle_collision(float *t_coll, Particle *p_i,
-                                                Particle *p_j);
+  collision_status_t time_of_particle_collision(sim_domain_t *d,
+                                                float *t_coll, particle_t p_i,
+                                                particle_t p_j);
 
   /**
    * @brief Checks particle for a single collision against field boundaries.
    *
-   * If collision occurs, will be pushed to `collision_queue`.
+   * If collision occurs, will be pushed to `cev`.
    *
-   * @param p location of particle data to check
+   * @param p handle of the particle to check
    * @param cev collision event vector to push to
    * @return COLLISION_TRUE if a collision occurred
    */
-  collision_status_t check_for_edge_collision(Particle *p,
+  collision_status_t check_for_edge_collision(particle_t p,
                                               std::vector<CollisionEvent> *cev);
 
-  // collision_status_t
-  // check_for_particle_collisions(Particle *p, std::vector<CollisionEvent>
-  // *cev);
+  /**
+   * @brief Checks a range of particles for collisions against field
+   * boundaries, in one batch (see `ParticleField::detect_edge_collisions()`).
+   *
+   * @param begin first particle to check
+   * @param end one past the last particle to check
+   * @param cev collision event vector to push to
+   * @return ERR_OK if the checks were successful
+   */
+  p_sim_error_t check_for_edge_collisions(particle_t begin, particle_t end,
+                                          std::vector<CollisionEvent> *cev);
+
+  /**
+   * @brief Computes the grid query box for a particle: its path over the rest
+   * of the timestep, padded by the radii and the travel of any other particle.
+   * @param p particle to query for
+   * @param lo where to store the lower corner
+   * @param hi where to store the upper corner
+   */
+  void candidate_box(particle_t p, sf::Vector2f *lo, sf::Vector2f *hi);
+
+  /**
+   * @brief Builds every particle's neighbor list (in parallel): the particles
+   * whose distance from it is at most their radii plus `reach`.
+   *
+   * A pair can only collide once its distance shrank to the radii, so the
+   * lists hold every pair that can collide as long as no particle gets
+   * further than half the `reach` from where it was at the build. Uses the
+   * grids, which must be built.
+   *
+   * @param reach list distance beyond the radii
+   */
+  void build_neighbors(float reach);
+
+  /**
+   * @brief Checks particle against nearby particles for collisions during the
+   * rest of the timestep, using the batch kernel.
+   *
+   * Candidates come from p's neighbor list while the lists are valid,
+   * otherwise from every domain's grid. While `windowed`, only `d`'s
+   * particles are candidates (then p is marked as leaked if a listed
+   * neighbor belongs to another domain, or its query box reaches outside
+   * the strip).
+   *
+   * @param d domain doing the detection
+   * @param p particle to check
+   * @param lower_only only test against particles with a lower id (so that
+   * each pair is tested once when every particle is checked)
+   * @param scratch scratch buffers for candidates and kernel hits
+   * @param cev collision event vector to push to
+   * @return number of pair tests performed
+   */
+  size_t check_for_particle_collisions(sim_domain_t *d, particle_t p,
+                                       bool lower_only,
+                                       detect_scratch_t *scratch,
+                                       std::vector<CollisionEvent> *cev);
+
+  /**
+   * @brief Offers an event to the slots of the particle(s) it involves.
+   *
+   * Each particle keeps only its earliest event (in its own domain's queue),
+   * so the event replaces a particle's scheduled event only if it is earlier.
+   * Particle-particle events are offered to both particles.
+   *
+   * @param d domain doing the detection (counts the pushes)
+   * @param event predicted event (absolute time)
+   */
+  void schedule_event(sim_domain_t *d, const CollisionEvent &event);
+
+  /**
+   * @brief Fills a domain's queue with the events of its particles among the
+   * ones in `detected`, keeping the earliest per particle (as
+   * `schedule_event()` would), then builds the heap in one go.
+   * @param d domain to fill (its queue is empty)
+   */
+  void seed_queue(sim_domain_t *d);
+
+  /**
+   * @brief Saves a particle and its scheduled event before the first change
+   * in the current window, so the window can be rolled back. No-op unless
+   * `windowed`.
+   * @param p particle about to change
+   */
+  void touch(particle_t p);
 
   /**
    * @brief Applies collision to particles.
@@ -76,47 +309,148 @@ private:
    * accordingly, and increments paricle versions for this timestep.
    *
    * If collision is valid, all particles in the event should be checked again
-   * for collisions against field boundaries and other particles, and any
-   * further collisions should be appended to `collision_queue`.`
+   * for collisions against field boundaries and other particles, and their
+   * next events scheduled.
    *
+   * @param d domain processing the event
    * @param event the colision event
    * @return COLLISION_TRUE if valid. COLLISION_FALSE if not.
    */
-  collision_status_t collide(CollisionEvent event);
+  collision_status_t collide(sim_domain_t *d, CollisionEvent event);
+
+  /**
+   * @brief Applies a (valid) particle-particle collision, see `collide()`.
+   *
+   * Instantiated per physics policy (PhysicsPolicy.hpp): with equal masses
+   * the impulse is split evenly (an elastic collision just swaps the normal
+   * velocity components), and elastic runs skip the restitution coefficient.
+   *
+   * @param d domain processing the event
+   * @param event the collision event
+   * @param physics radius, mass and restitution policies
+   * @return COLLISION_TRUE if applied, COLLISION_FALSE if the particles were
+   * not approaching
+   */
+  template <typename PairPhysics>
+  collision_status_t collide_particles(sim_domain_t *d,
+                                       const CollisionEvent &event,
+                                       const PairPhysics &physics);
 
   /**
-   * @brief Re-detects collisions for particles after they have collided.
+   * @brief Re-detects collisions for particles after they have collided (or
+   * after their scheduled event turned out to be stale).
    *
    * Called after processing a collision to find new potential collisions
-   * resulting from the particles' changed trajectories. Detection is
-   * parallelized across particle-particle checks.
+   * resulting from the particles' changed trajectories. The particles are
+   * brought to the domain's `t_now`, re-binned in their grid and only checked
+   * against their neighbors (list or grid). Their previous events are dropped
+   * and replaced by the earliest new ones.
    *
+   * @param d domain processing the event
    * @param affected vector of particles that need re-detection
+   * @param exclude partner to ignore (a pair that just touched without
+   * approaching), or PARTICLE_NONE
    */
-  void redetect_collisions_for_particles(std::vector<Particle *> &affected);
+  void redetect_collisions_for_particles(sim_domain_t *d,
+                                         std::vector<particle_t> &affected,
+                                         particle_t exclude);
 
   /**
-   * @brief Process collisions in CollisionQueue for timestep t0 -> t1
+   * @brief Queue holding the next event to process: `d`'s own queue while
+   * `windowed`, otherwise the earliest among all domains (k-way min).
+   * @param d domain processing events
+   * @return the queue, or NULL if there are no events left
+   */
+  CollisionQueue *next_queue(sim_domain_t *d);
+
+  /**
+   * @brief Processes events in time order up to t_end.
    *
-   * In implementation, will iterate collision events from collision_queue,
-   * apply the collision events using `collide()` (and call
-   * `check_for_collisions()` if collisions are valid), and repeat until
-   * `collision_queue` is empty.
+   * Iterates collision events, applies them using `collide()` and re-detects
+   * collisions for the particles involved (for a stale event, only its owner)
+   * until no event at or before t_end is left. While `windowed`, stops early
+   * (setting `d->conflict`) at an event involving another domain's particle.
    *
+   * @param d domain processing the events
+   * @param t_end last event time to process
    * @return ERR_OK if successful
    */
-  p_sim_error_t process_collisions();
+  p_sim_error_t process_events(sim_domain_t *d, float t_end);
+
+  /**
+   * @brief Splits the particles into one domain per strip (per thread) and
+   * bins each domain's particles in its grid.
+   * @param n_domains number of strips
+   * @param cell_size grid cell size
+   * @return ERR_OK if successful
+   */
+  p_sim_error_t partition(uint32_t n_domains, float cell_size);
+
+  /**
+   * @brief Whether particle p's path this window (states in `path`) can have
+   * touched one of another domain's particles, which then invalidates the
+   * window.
+   * @param p a particle that leaked this window
+   * @param t0 window start
+   * @param t1 window end
+   * @param path scratch vector for p's path
+   * @param other_path scratch vector for the other particles' paths
+   */
+  bool leak_conflicts(particle_t p, float t0, float t1,
+                      std::vector<particle_state_t> *path,
+                      std::vector<particle_state_t> *other_path);
+
+  /**
+   * @brief Collects a particle's path this window: its state at the window
+   * start, then its state after each collision.
+   */
+  void path_of(particle_t p, std::vector<particle_state_t> *path);
 
   /**
-   * @brief creates a tracer of a particle
+   * @brief Processes the timestep in windows, with every domain processing
+   * its own events concurrently (optimistically).
    *
+   * A window is valid if no domain needed another domain's particle: no
+   * event across strips, no particle faster than `v_max` (which bounds how
+   * far particles drift out of their strip), and no leaked particle's path
+   * touching another domain's. A valid window's leaked particles are then
+   * re-detected against every domain. An invalid window is rolled back and
+   * processed serially, so results match the serial path either way. The
+   * window length adapts: halved after a rollback, grown after a success.
+   * When windows keep rolling back, the rest of the timestep and the next
+   * few are processed serially (see PARALLEL_EVENT_BACKOFF_MAX).
+   *
+   * @return ERR_OK if successful
+   */
+  p_sim_error_t process_windows();
+
+  /** @brief Zeroes the counters and phase times, see `get_stats()`. */
+  void clear_stats();
+
+  /**
+   * @brief Picks the pair physics specialization the particles allow
+   * (uniform radius, elastic), unless the config disables specialization.
+   */
+  void select_physics();
+
+  /**
+   * @brief Process collisions for timestep t0 -> t1, serially with a single
+   * domain, or in parallel windows (see `process_windows()`).
    * @return ERR_OK if successful
    */
-  p_sim_error_t make_tracer(Particle *p);
+  p_sim_error_t process_collisions();
 
 public:
   /**
-   * @brief ParticleSim constructor (with NULL field)
+   * @brief ParticleSim constructor (with NULL field) from a sim config.
+   * @param config sim config (particle count, field geometry, restitution,
+   * colors)
+   * @return Sim in the STATE_INIT state.
+   */
+  ParticleSim(const SimConfig &config);
+
+  /**
+   * @brief ParticleSim constructor (with NULL field), default config.
    * @return Sim in the STATE_INIT state.
    */
   ParticleSim(uint32_t n);
@@ -136,11 +470,39 @@ public:
   p_sim_error_t assign_field(ParticleField *field);
 
   /**
-   * @brief Begins the particle sim.
+   * @brief Attaches a trajectory writer (opened by the caller), which then
+   * records the particles at the end of every `update()`. NULL detaches it.
+   * @param writer TrajectoryWriter pointer, or NULL
+   */
+  void assign_trajectory(TrajectoryWriter *writer);
+
+  /**
+   * @brief Begins the particle sim: generates the particles (drawing from an
+   * RNG seeded with the config's seed), and picks the pair physics
+   * specialization they allow (uniform radius, elastic), unless the config
+   * disables specialization.
    * @return ERR_OK if successful.
    */
   p_sim_error_t begin();
 
+  /**
+   * @brief Begins the particle sim from a checkpoint instead of generating
+   * particles: restores the particles, RNG state and timestep counter. The
+   * field geometry in the config must match the checkpoint's (see
+   * `Checkpoint::apply_to_config()`).
+   * @param path checkpoint file path
+   * @return ERR_OK if successful, ERR_INVALID_STATE if the field does not
+   * match, or the error of `Checkpoint::read()`
+   */
+  p_sim_error_t restore(const char *path);
+
+  /**
+   * @brief Saves the sim (between timesteps) to a checkpoint file.
+   * @param path checkpoint file path
+   * @return ERR_OK if successful, or the error of `Checkpoint::write()`
+   */
+  p_sim_error_t save_checkpoint(const char *path);
+
   /**
    * @brief Updates the particle sim to the next timestep. Collision checking
    * will occur.
@@ -149,12 +511,56 @@ public:
   p_sim_error_t update();
 
   /**
-   * @brief Renders the simulation (particles + field boundary) onto SFML
-   * Window.
+   * @brief Advances the particle sim by several timesteps back to back, with
+   * nothing in between (no rendering, no frame pacing). Only the last one is
+   * captured for `render()`; every one is still recorded to the trajectory.
+   * @param n_steps number of timesteps to run
+   * @return ERR_OK if successful.
+   */
+  p_sim_error_t step(uint32_t n_steps);
+
+  /**
+   * @brief Work counters accumulated since the sim began.
+   */
+  sim_counters_t get_counters();
+
+  /**
+   * @brief Counters and per-phase times since the sim began. Safe to call
+   * between updates, also while rendering.
+   */
+  sim_stats_t get_stats();
+
+  /**
+   * @brief Writes `get_stats()` as one line (totals, and milliseconds per
+   * timestep / per frame for the phases). `update()` also does this to
+   * stderr every `stats_every` timesteps if set.
+   * @param out output stream
+   */
+  void print_stats(FILE *out);
+
+  /** @brief Timesteps run, including those before a restored checkpoint. */
+  uint64_t get_timestep();
+
+#ifndef HEADLESS
+  /**
+   * @brief Makes the snapshot captured at the end of the last `update()` the
+   * one `render()` draws (does nothing if there is no new one). Must not run
+   * concurrently with `render()`.
+   */
+  void publish();
+
+  /**
+   * @brief Renders the published snapshot (particles + field boundary) onto
+   * SFML Window. Particles and trails are batched into a single draw call.
+   *
+   * Reads nothing that `update()` writes, so it may run on one thread while
+   * the next `update()` runs on another (then call `publish()` once both are
+   * done).
    * @param window SFML window
    * @return ERR_OK if successful
    */
   p_sim_error_t render(sf::RenderWindow *window);
+#endif
 };
 
 #endif
@@ -0,0 +1,69 @@
+#include "ParticleStore.hpp"
+
+particle_t ParticleStore::add(sf::Vector2f position, float radius,
+                              sf::Color color)
+{
+  particle_t i = (particle_t)this->x.size();
+  this->x.push_back(position.x);
+  this->y.push_back(position.y);
+  this->vx.push_back(0.0f);
+  this->vy.push_back(0.0f);
+  this->radius.push_back(radius);
+  this->mass.push_back(radius * radius);
+  this->t_current.push_back(0.0f);
+  this->edge_collision_time.push_back(-1.0f);
+  this->version.push_back(0);
+  this->enabled.push_back(1);
+  this->color.push_back(color);
+  return i;
+}
+
+void ParticleStore::reserve(size_t n)
+{
+  this->x.reserve(n);
+  this->y.reserve(n);
+  this->vx.reserve(n);
+  this->vy.reserve(n);
+  this->radius.reserve(n);
+  this->mass.reserve(n);
+  this->t_current.reserve(n);
+  this->edge_collision_time.reserve(n);
+  this->version.reserve(n);
+  this->enabled.reserve(n);
+  this->color.reserve(n);
+}
+
+void ParticleStore::clear()
+{
+  this->x.clear();
+  this->y.clear();
+  this->vx.clear();
+  this->vy.clear();
+  this->radius.clear();
+  this->mass.clear();
+  this->t_current.clear();
+  this->edge_collision_time.clear();
+  this->version.clear();
+  this->enabled.clear();
+  this->color.clear();
+}
+
+sf::Color ParticleStore::get_color(particle_t i,
+                                   const speed_colors_t &speed_colors) const
+{
+  sf::Color p_color = this->color[i];
+  if (speed_colors.enabled)
+  {
+    float p_speed = this->get_speed(i);
+    if (p_speed > speed_colors.max)
+      p_speed = speed_colors.max;
+    int delta_r, delta_g, delta_b;
+    float intensity = p_speed / speed_colors.max;
+    delta_r = static_cast<int>(speed_colors.mod_r * intensity);
+    delta_g = static_cast<int>(speed_colors.mod_g * intensity);
+    delta_b = static_cast<int>(speed_colors.mod_b * intensity);
+    return sf::Color(p_color.r + delta_r, p_color.g + delta_g,
+                     p_color.b + delta_b);
+  }
+  return p_color;
+}
@@ -0,0 +1,203 @@
+#ifndef __PARTICLESTORE_HPP__
+#define __PARTICLESTORE_HPP__
+
+#include "SimConfig.hpp"
+#include "config.h"
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/System/Vector2.hpp>
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+#include <vector>
+
+#define PARTICLE_STORE_ALIGN 64 // cache line (and widest SIMD register)
+
+typedef uint32_t particle_t; // index-based particle handle
+#define PARTICLE_NONE UINT32_MAX
+
+/**
+ * @brief Minimal allocator handing out PARTICLE_STORE_ALIGN aligned blocks,
+ * so that each particle attribute array starts on a cache line.
+ */
+template <typename T> struct AlignedAllocator
+{
+  typedef T value_type;
+  AlignedAllocator() = default;
+  template <typename U> AlignedAllocator(const AlignedAllocator<U> &) {}
+  T *allocate(std::size_t n)
+  {
+    return static_cast<T *>(::operator new(
+        n * sizeof(T), std::align_val_t(PARTICLE_STORE_ALIGN)));
+  }
+  void deallocate(T *p, std::size_t)
+  {
+    ::operator delete(p, std::align_val_t(PARTICLE_STORE_ALIGN));
+  }
+  template <typename U> bool operator==(const AlignedAllocator<U> &) const
+  {
+    return true;
+  }
+  template <typename U> bool operator!=(const AlignedAllocator<U> &) const
+  {
+    return false;
+  }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+/**
+ * @brief Snapshot of the per-timestep state of one particle (everything
+ * collisions change), see `ParticleStore::save()`.
+ */
+typedef struct
+{
+  particle_t p;
+  float t_current;
+  float x, y;
+  float vx, vy;
+  float edge_collision_time;
+  int32_t version;
+} particle_state_t;
+
+/**
+ * @brief Structure-of-arrays particle storage.
+ *
+ * Every particle attribute lives in its own contiguous, aligned array, and a
+ * particle is identified by its index (`particle_t`) into those arrays. The
+ * arrays are public so collision kernels can stream them directly; the inline
+ * helpers below cover the common per-particle operations.
+ */
+class ParticleStore
+{
+public:
+  aligned_vector<float> x;  // position x
+  aligned_vector<float> y;  // position y
+  aligned_vector<float> vx; // velocity x
+  aligned_vector<float> vy; // velocity y
+  aligned_vector<float> radius;
+  aligned_vector<float> mass;
+  aligned_vector<float> t_current; // particle's current time in the timestep
+  aligned_vector<float> edge_collision_time;
+  aligned_vector<int32_t> version;
+  aligned_vector<uint8_t> enabled;
+  std::vector<sf::Color> color;
+
+  /**
+   * @brief Adds a particle at rest.
+   * @param position particle position
+   * @param radius particle radius (mass is radius squared)
+   * @param color base particle color
+   * @return handle of the new particle
+   */
+  particle_t add(sf::Vector2f position, float radius, sf::Color color);
+
+  /** @brief Reserves room for n particles in every array. */
+  void reserve(size_t n);
+
+  /** @brief Removes all particles (keeps the allocations). */
+  void clear();
+
+  /** @brief Number of particles in the store. */
+  size_t size() const { return this->x.size(); }
+
+  /** @brief Resets per-timestep collision bookkeeping for a particle. */
+  void reset(particle_t i)
+  {
+    this->version[i] = 0;
+    this->edge_collision_time[i] = -1.0f;
+    this->t_current[i] = 0.0f;
+  }
+
+  sf::Vector2f get_position(particle_t i) const
+  {
+    return sf::Vector2f(this->x[i], this->y[i]);
+  }
+  void set_position(particle_t i, sf::Vector2f position)
+  {
+    this->x[i] = position.x;
+    this->y[i] = position.y;
+  }
+  /** @brief Sets a particle's radius (and its mass, radius squared). */
+  void set_radius(particle_t i, float radius)
+  {
+    this->radius[i] = radius;
+    this->mass[i] = radius * radius;
+  }
+  sf::Vector2f get_velocity(particle_t i) const
+  {
+    return sf::Vector2f(this->vx[i], this->vy[i]);
+  }
+  void set_velocity(particle_t i, sf::Vector2f v)
+  {
+    this->vx[i] = v.x;
+    this->vy[i] = v.y;
+  }
+  void add_velocity(particle_t i, sf::Vector2f v)
+  {
+    this->vx[i] += v.x;
+    this->vy[i] += v.y;
+  }
+  float get_speed(particle_t i) const
+  {
+    return std::sqrt(this->vx[i] * this->vx[i] + this->vy[i] * this->vy[i]);
+  }
+  sf::Vector2f get_momentum(particle_t i) const
+  {
+    return this->mass[i] * this->get_velocity(i);
+  }
+
+  /** @brief Position of particle i extrapolated to time t. */
+  sf::Vector2f position_at(particle_t i, float t) const
+  {
+    float dt = t - this->t_current[i];
+    return sf::Vector2f(this->x[i] + this->vx[i] * dt,
+                        this->y[i] + this->vy[i] * dt);
+  }
+
+  /**
+   * @brief Moves particle i along its velocity.
+   * @param i particle handle
+   * @param dt time to advance
+   */
+  void advance(particle_t i, float dt)
+  {
+    if (PARTICLE_DISABLE_STOP && !this->enabled[i])
+      return;
+    this->x[i] += dt * this->vx[i];
+    this->y[i] += dt * this->vy[i];
+    this->t_current[i] += dt;
+  }
+
+  /** @brief Snapshot of particle i's per-timestep state. */
+  particle_state_t save(particle_t i) const
+  {
+    return particle_state_t({i, this->t_current[i], this->x[i], this->y[i],
+                             this->vx[i], this->vy[i],
+                             this->edge_collision_time[i], this->version[i]});
+  }
+
+  /** @brief Puts a particle back into a state taken by `save()`. */
+  void restore(const particle_state_t &state)
+  {
+    particle_t i = state.p;
+    this->t_current[i] = state.t_current;
+    this->x[i] = state.x;
+    this->y[i] = state.y;
+    this->vx[i] = state.vx;
+    this->vy[i] = state.vy;
+    this->edge_collision_time[i] = state.edge_collision_time;
+    this->version[i] = state.version;
+  }
+
+  void disable(particle_t i) { this->enabled[i] = 0; }
+
+  /**
+   * @brief Display color of particle i.
+   * @param speed_colors speed tinting (applied if enabled)
+   */
+  sf::Color get_color(particle_t i, const speed_colors_t &speed_colors) const;
+};
+
+#endif
@@ -1,47 +1,74 @@
 #include "ParticleTracer.hpp"
+
+#ifndef HEADLESS
 #include <stdint.h>
 
 #include "config.h"
 
-#define MOD_R (PARTICLE_TRACER_MOD_R - PARTICLE_TRACER) / PARTICLE_TRACER
-#define MOD_G (PARTICLE_TRACER_MOD_G - PARTICLE_TRACER) / PARTICLE_TRACER
-#define MOD_B (PARTICLE_TRACER_MOD_B - PARTICLE_TRACER) / PARTICLE_TRACER
-
-ParticleTracer::ParticleTracer(Particle *p, uint8_t timestep)
+ParticleTracer::ParticleTracer(const SimConfig &config)
 {
-  this->position = p->get_position();
-  this->color = p->get_color();
-  this->radius = p->get_radius();
-  this->timestep = timestep;
+  this->n_particles = 0;
+  this->length = (int32_t)config.tracer;
+  this->mod_r = (config.tracer_mod_r - this->length) / this->length;
+  this->mod_g = (config.tracer_mod_g - this->length) / this->length;
+  this->mod_b = (config.tracer_mod_b - this->length) / this->length;
+  this->capacity = this->length > 1 ? (uint32_t)this->length - 1 : 0;
+  this->head = 0;
+  this->filled = 0;
 }
 
-bool ParticleTracer::render(sf::RenderWindow *window)
+void ParticleTracer::record(const RenderSnapshot *snapshot)
 {
-  if (this->timestep == PARTICLE_TRACER)
+  if (0 == this->capacity)
+    return;
+  uint32_t n = (uint32_t)snapshot->size();
+  if (n != this->n_particles)
+  {
+    // (Re)size once; trails restart if the particle count changes
+    this->n_particles = n;
+    this->positions.assign((size_t)n * this->capacity, sf::Vector2f());
+    this->colors.assign((size_t)n * this->capacity, sf::Color());
+    this->head = 0;
+    this->filled = 0;
+  }
+  size_t base = (size_t)this->head * n;
+  for (particle_t p = 0; p < n; p++)
   {
-    this->timestep -= 1;
-    return true;
+    this->positions[base + p] = snapshot->position[p];
+    this->colors[base + p] = snapshot->color[p];
   }
-  if (this->timestep <= 0)
+  this->head = (this->head + 1) % this->capacity;
+  if (this->filled < this->capacity)
+    this->filled++;
+}
+
+void ParticleTracer::render(const RenderSnapshot *snapshot, DiscBatch *batch,
+                            float pixel_scale) const
+{
+  uint32_t n = this->n_particles;
+  if (n != snapshot->size())
+    return;
+  // Oldest first, so newer trail discs are drawn on top
+  for (uint32_t age = this->filled; age >= 1; age--)
   {
-    return false;
+    uint32_t slot = (this->head + this->capacity - age) % this->capacity;
+    // Same fade as a single tracer: timestep counts down from length
+    int32_t timestep = this->length - (int32_t)age;
+    int32_t fade = this->length - timestep;
+    size_t base = (size_t)slot * n;
+    for (particle_t p = 0; p < n; p++)
+    {
+      if (PARTICLE_DISABLE_DISAPPEAR && !snapshot->enabled[p])
+        continue;
+      sf::Color fill_color = this->colors[base + p];
+      fill_color.r = fill_color.r + (this->mod_r * fade);
+      fill_color.g = fill_color.g + (this->mod_g * fade);
+      fill_color.b = fill_color.b + (this->mod_b * fade);
+      fill_color.a = (255 * timestep) / this->length;
+      batch->add(this->positions[base + p], snapshot->radius[p], pixel_scale,
+                 fill_color);
+    }
   }
-  sf::Color fill_color = this->color;
-  fill_color.r = fill_color.r + (MOD_R * (PARTICLE_TRACER - this->timestep));
-  fill_color.g = fill_color.g + (MOD_G * (PARTICLE_TRACER - this->timestep));
-  fill_color.b = fill_color.b + (MOD_B * (PARTICLE_TRACER - this->timestep));
-  fill_color.a = (255 * this->timestep) / PARTICLE_TRACER;
-#ifdef DEBUG
-  printf("step %d: %d %d %d\n", this->timestep, fill_color.r, fill_color.g,
-         fill_color.b);
-#endif
-  // fill_color.b);
-  this->timestep -= 1;
-  sf::CircleShape shape(this->radius, 100);
-  sf::Vector2f center_position =
-      this->position - sf::Vector2f(this->radius, this->radius);
-  shape.setPosition(center_position);
-  shape.setFillColor(fill_color);
-  window->draw(shape);
-  return true;
 }
+
+#endif // HEADLESS
@@ -1,20 +1,62 @@
 #ifndef __PARTICLETRACER_HPP__
 #define __PARTICLETRACER_HPP__
 
-#include "Particle.hpp"
+#ifndef HEADLESS
+
+#include "DiscBatch.hpp"
+#include "RenderSnapshot.hpp"
+#include "SimConfig.hpp"
 #include <SFML/Graphics.hpp>
+#include <stdint.h>
+#include <vector>
 
+/**
+ * @brief Trails of past particle positions, kept in a ring buffer of the last
+ * `tracer` - 1 frames for every particle (see SimConfig).
+ *
+ * Storage is sized once for the particle count; recording a frame overwrites
+ * the oldest one, so steady state does no allocation and the cost per frame
+ * is bounded by N x `tracer`.
+ */
 class ParticleTracer
 {
 private:
-  sf::Vector2f position;
-  sf::Color color;
-  uint8_t timestep;
-  float radius;
+  uint32_t n_particles;
+  int32_t length;    // trail length, counting the particle itself
+  int32_t mod_r;     // per-frame color shift with age
+  int32_t mod_g;
+  int32_t mod_b;
+  uint32_t capacity; // frames kept per particle
+  uint32_t head;     // ring slot the next frame is recorded into
+  uint32_t filled;   // frames recorded so far (up to capacity)
+  std::vector<sf::Vector2f> positions; // [slot * n_particles + particle]
+  std::vector<sf::Color> colors;
 
 public:
-  ParticleTracer(Particle *p, uint8_t timestep);
-  bool render(sf::RenderWindow *window);
+  /**
+   * @brief Tracer with the trail length and colors of a sim config.
+   * @param config sim config (`tracer`, `tracer_mod_*`)
+   */
+  ParticleTracer(const SimConfig &config);
+
+  /**
+   * @brief Records the position and color of every particle in a snapshot as
+   * the newest trail frame.
+   * @param snapshot rendered particles
+   */
+  void record(const RenderSnapshot *snapshot);
+
+  /**
+   * @brief Appends the trails (oldest frame first, fading with age) to a
+   * batch.
+   * @param snapshot rendered particles (for radii and enabled state)
+   * @param batch disc batch to append to
+   * @param pixel_scale pixels per world unit
+   */
+  void render(const RenderSnapshot *snapshot, DiscBatch *batch,
+              float pixel_scale) const;
 };
 
+#endif // HEADLESS
+
 #endif
@@ -0,0 +1,99 @@
+#ifndef __PHYSICSPOLICY_HPP__
+#define __PHYSICSPOLICY_HPP__
+
+#include "ParticleStore.hpp"
+#include <stdint.h>
+
+/*
+ * Policies for the particle-pair physics. The collision kernels and
+ * `ParticleSim::collide_particles()` are instantiated per policy, so the
+ * special cases (monodisperse, perfectly elastic) compile to straight-line
+ * code without per-pair loads or branches. See `physics_t`.
+ */
+
+/** @brief Radii read per particle: contact distance r_i + r_j. */
+struct PerParticleRadius
+{
+  static constexpr bool UNIFORM = false;
+  float contact(const ParticleStore *ps, particle_t i, particle_t j) const
+  {
+    return ps->radius[i] + ps->radius[j];
+  }
+  float contact_sq(const ParticleStore *ps, particle_t i, particle_t j) const
+  {
+    float R = ps->radius[i] + ps->radius[j];
+    return R * R;
+  }
+};
+
+/** @brief Every particle has the same radius: constant contact distance. */
+struct UniformRadius
+{
+  static constexpr bool UNIFORM = true;
+  float R;    // contact distance, 2r
+  float R_sq; // and its square, as PerParticleRadius rounds it
+  float contact(const ParticleStore *, particle_t, particle_t) const
+  {
+    return this->R;
+  }
+  float contact_sq(const ParticleStore *, particle_t, particle_t) const
+  {
+    return this->R_sq;
+  }
+};
+
+/** @brief Masses read per particle. */
+struct VariableMass
+{
+  static constexpr bool EQUAL = false;
+};
+
+/** @brief Every particle has the same mass (impulses split evenly). */
+struct EqualMass
+{
+  static constexpr bool EQUAL = true;
+};
+
+/** @brief Perfectly elastic collisions (restitution 1). */
+struct Elastic
+{
+  float coeff() const { return 1.0f; }
+};
+
+/** @brief Collisions with a coefficient of restitution. */
+struct Restitution
+{
+  float e;
+  float coeff() const { return this->e; }
+};
+
+/**
+ * @brief A combination of radius, mass and restitution policies.
+ */
+template <typename RadiusPolicy, typename MassPolicy, typename ElasticPolicy>
+struct Physics
+{
+  typedef RadiusPolicy Radius;
+  typedef MassPolicy Mass;
+  typedef ElasticPolicy Elasticity;
+  Radius radius;
+  Elasticity elasticity;
+};
+
+/*
+ * Physics picked by ParticleSim::begin() and restore(). Mass is radius
+ * squared, so equal radii mean equal masses: the radius and mass policies go
+ * together.
+ */
+typedef uint8_t physics_t;
+#define PHYSICS_GENERAL 0 // per-particle radius and mass, restitution
+#define PHYSICS_ELASTIC 1 // per-particle radius and mass, elastic
+#define PHYSICS_UNIFORM 2 // uniform radius and mass, restitution
+#define PHYSICS_UNIFORM_ELASTIC 3 // uniform radius and mass, elastic
+
+typedef Physics<PerParticleRadius, VariableMass, Restitution> GeneralPhysics;
+typedef Physics<PerParticleRadius, VariableMass, Elastic> ElasticPhysics;
+typedef Physics<UniformRadius, EqualMass, Restitution> UniformPhysics;
+typedef Physics<UniformRadius, EqualMass, Elastic> UniformElasticPhysics;
+
+#endif
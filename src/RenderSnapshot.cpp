@@ -0,0 +1,22 @@
+#include "RenderSnapshot.hpp"
+
+#ifndef HEADLESS
+
+void RenderSnapshot::capture(const ParticleStore *store,
+                             const speed_colors_t &speed_colors,
+                             uint64_t timestep)
+{
+  size_t n = store->size();
+  this->position.resize(n);
+  this->radius.assign(store->radius.begin(), store->radius.end());
+  this->color.resize(n);
+  this->enabled.assign(store->enabled.begin(), store->enabled.end());
+  _Pragma("omp parallel for") for (size_t i = 0; i < n; i++)
+  {
+    this->position[i] = store->get_position((particle_t)i);
+    this->color[i] = store->get_color((particle_t)i, speed_colors);
+  }
+  this->timestep = timestep;
+}
+
+#endif // HEADLESS
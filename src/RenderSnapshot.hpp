@@ -0,0 +1,47 @@
+#ifndef __RENDERSNAPSHOT_HPP__
+#define __RENDERSNAPSHOT_HPP__
+
+#ifndef HEADLESS
+
+#include "ParticleStore.hpp"
+#include "SimConfig.hpp"
+#include <SFML/Graphics.hpp>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief What the renderer needs of the particles after a timestep:
+ * positions, radii, display colors and enabled flags.
+ *
+ * The sim captures one at the end of every `update()` into its back buffer
+ * and the renderer only ever reads the front one, so drawing a frame never
+ * touches the particle store that the next update is changing. The vectors
+ * keep their storage between captures.
+ */
+class RenderSnapshot
+{
+public:
+  std::vector<sf::Vector2f> position;
+  std::vector<float> radius;
+  std::vector<sf::Color> color; // with speed tinting applied
+  std::vector<uint8_t> enabled;
+  uint64_t timestep; // timestep the particles are at
+
+  RenderSnapshot() : timestep(0) {}
+
+  /** @brief Number of particles in the snapshot. */
+  size_t size() const { return this->position.size(); }
+
+  /**
+   * @brief Copies the particles' current state.
+   * @param store particle storage
+   * @param speed_colors speed tinting of the colors
+   * @param timestep timestep the particles are at
+   */
+  void capture(const ParticleStore *store, const speed_colors_t &speed_colors,
+               uint64_t timestep);
+};
+
+#endif // HEADLESS
+
+#endif
@@ -0,0 +1,339 @@
+#include "SimConfig.hpp"
+#include "config.h"
+
+#include <cstddef> // for offsetof()
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_LINE_MAX 512
+
+typedef uint8_t config_type_t;
+#define CONFIG_UINT 0
+#define CONFIG_INT 1
+#define CONFIG_FLOAT 2
+#define CONFIG_BOOL 3
+
+/**
+ * @brief A settable parameter: its name, type and location in SimConfig.
+ */
+typedef struct
+{
+  const char *name;
+  config_type_t type;
+  size_t offset;
+} config_key_t;
+
+#define CONFIG_KEY(name, type, member)                                         \
+  {name, type, offsetof(SimConfig, member)}
+
+static const config_key_t CONFIG_KEYS[] = {
+    CONFIG_KEY("particles", CONFIG_UINT, n_particles),
+    CONFIG_KEY("seed", CONFIG_UINT, seed),
+    CONFIG_KEY("radius_min", CONFIG_FLOAT, radius_min),
+    CONFIG_KEY("radius_max", CONFIG_FLOAT, radius_max),
+    CONFIG_KEY("v0_max", CONFIG_FLOAT, v0_max),
+    CONFIG_KEY("placement", CONFIG_UINT, placement),
+    CONFIG_KEY("elastic_coeff", CONFIG_FLOAT, elastic_coeff),
+    CONFIG_KEY("specialize", CONFIG_BOOL, specialize),
+    CONFIG_KEY("calendar_queue", CONFIG_BOOL, calendar_queue),
+    CONFIG_KEY("neighbor_lists", CONFIG_BOOL, neighbor_lists),
+    CONFIG_KEY("neighbor_skin", CONFIG_FLOAT, neighbor_skin),
+    CONFIG_KEY("field_center_x", CONFIG_FLOAT, field_center_x),
+    CONFIG_KEY("field_center_y", CONFIG_FLOAT, field_center_y),
+    CONFIG_KEY("field_radius", CONFIG_FLOAT, field_radius),
+    CONFIG_KEY("speed_colors", CONFIG_BOOL, speed_colors.enabled),
+    CONFIG_KEY("speed_colors_max", CONFIG_FLOAT, speed_colors.max),
+    CONFIG_KEY("speed_color_mod_r", CONFIG_INT, speed_colors.mod_r),
+    CONFIG_KEY("speed_color_mod_g", CONFIG_INT, speed_colors.mod_g),
+    CONFIG_KEY("speed_color_mod_b", CONFIG_INT, speed_colors.mod_b),
+    CONFIG_KEY("tracer", CONFIG_UINT, tracer),
+    CONFIG_KEY("tracer_mod_r", CONFIG_INT, tracer_mod_r),
+    CONFIG_KEY("tracer_mod_g", CONFIG_INT, tracer_mod_g),
+    CONFIG_KEY("tracer_mod_b", CONFIG_INT, tracer_mod_b),
+    CONFIG_KEY("window_size_x", CONFIG_UINT, window_size_x),
+    CONFIG_KEY("window_size_y", CONFIG_UINT, window_size_y),
+    CONFIG_KEY("framerate", CONFIG_FLOAT, framerate),
+    CONFIG_KEY("steps_per_frame", CONFIG_UINT, steps_per_frame),
+    CONFIG_KEY("fast_forward", CONFIG_BOOL, fast_forward),
+    CONFIG_KEY("stats_every", CONFIG_UINT, stats_every),
+    CONFIG_KEY("trajectory_every", CONFIG_UINT, trajectory_every),
+    CONFIG_KEY("trajectory_block", CONFIG_UINT, trajectory_block),
+    CONFIG_KEY("trajectory_pos_quantum", CONFIG_FLOAT, trajectory_pos_quantum),
+    CONFIG_KEY("trajectory_vel_quantum", CONFIG_FLOAT, trajectory_vel_quantum),
+};
+#define N_CONFIG_KEYS (sizeof(CONFIG_KEYS) / sizeof(CONFIG_KEYS[0]))
+
+/**
+ * Static helper: looks up a parameter by name (the first name_len characters
+ * of name).
+ */
+static const config_key_t *find_key(const char *name, size_t name_len)
+{
+  for (size_t k = 0; k < N_CONFIG_KEYS; k++)
+  {
+    if (strlen(CONFIG_KEYS[k].name) == name_len &&
+        !strncmp(CONFIG_KEYS[k].name, name, name_len))
+      return &CONFIG_KEYS[k];
+  }
+  return NULL;
+}
+
+/**
+ * Static helper: strips leading and trailing whitespace in place.
+ */
+static char *trim(char *s)
+{
+  while (*s == ' ' || *s == '\t')
+    s++;
+  size_t len = strlen(s);
+  while (len > 0 && strchr(" \t\r\n", s[len - 1]))
+    s[--len] = '\0';
+  return s;
+}
+
+SimConfig::SimConfig()
+{
+  this->n_particles = PARTICLE_QUANTITY;
+  this->seed = 1;
+  this->radius_min = PARTICLE_RADIUS_MIN;
+  this->radius_max = PARTICLE_RADIUS_MAX;
+  this->v0_max = V0_MAX;
+  this->placement = PARTICLE_PLACEMENT;
+  this->elastic_coeff = PARTICLE_ELASTIC_COEFF;
+  this->specialize = PARTICLE_SPECIALIZE == 1;
+  this->calendar_queue = SIM_CALENDAR_QUEUE == 1;
+  this->neighbor_lists = NEIGHBOR_LISTS == 1;
+  this->neighbor_skin = NEIGHBOR_SKIN;
+  this->field_center_x = PARTICLE_FIELD_CENTER_X;
+  this->field_center_y = PARTICLE_FIELD_CENTER_Y;
+  this->field_radius = PARTICLE_FIELD_RADIUS;
+  this->speed_colors.enabled = PARTICLE_SPEED_COLORS == 1;
+  this->speed_colors.max = PARTICLE_SPEED_COLORS_MAX;
+  this->speed_colors.mod_r = PARTICLE_SPEED_COLOR_MOD_R;
+  this->speed_colors.mod_g = PARTICLE_SPEED_COLOR_MOD_G;
+  this->speed_colors.mod_b = PARTICLE_SPEED_COLOR_MOD_B;
+  this->tracer = PARTICLE_TRACER;
+  this->tracer_mod_r = PARTICLE_TRACER_MOD_R;
+  this->tracer_mod_g = PARTICLE_TRACER_MOD_G;
+  this->tracer_mod_b = PARTICLE_TRACER_MOD_B;
+  this->window_size_x = WINDOW_SIZE_X;
+  this->window_size_y = WINDOW_SIZE_Y;
+  this->framerate = FRAMERATE;
+  this->steps_per_frame = STEPS_PER_FRAME;
+  this->fast_forward = FAST_FORWARD == 1;
+  this->stats_every = SIM_STATS_EVERY;
+  this->trajectory_every = TRAJECTORY_EVERY;
+  this->trajectory_block = TRAJECTORY_BLOCK;
+  this->trajectory_pos_quantum = TRAJECTORY_POS_QUANTUM;
+  this->trajectory_vel_quantum = TRAJECTORY_VEL_QUANTUM;
+}
+
+p_sim_error_t SimConfig::set(const char *key, const char *value)
+{
+  if (NULL == key || NULL == value)
+    return ERR_NULL_PTR;
+  const config_key_t *k = find_key(key, strlen(key));
+  if (NULL == k)
+    return ERR_CONFIG_KEY;
+  char *field = (char *)this + k->offset;
+  char *end = NULL;
+  switch (k->type)
+  {
+  case CONFIG_UINT:
+  {
+    if (strchr(value, '-'))
+      return ERR_CONFIG_VALUE;
+    unsigned long v = strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || v > UINT32_MAX)
+      return ERR_CONFIG_VALUE;
+    *(uint32_t *)field = (uint32_t)v;
+    break;
+  }
+  case CONFIG_INT:
+  {
+    long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v < INT32_MIN || v > INT32_MAX)
+      return ERR_CONFIG_VALUE;
+    *(int32_t *)field = (int32_t)v;
+    break;
+  }
+  case CONFIG_FLOAT:
+  {
+    float v = strtof(value, &end);
+    if (end == value || *end != '\0')
+      return ERR_CONFIG_VALUE;
+    *(float *)field = v;
+    break;
+  }
+  case CONFIG_BOOL:
+  {
+    if (!strcmp(value, "1") || !strcmp(value, "true") || !strcmp(value, "on"))
+      *(bool *)field = true;
+    else if (!strcmp(value, "0") || !strcmp(value, "false") ||
+             !strcmp(value, "off"))
+      *(bool *)field = false;
+    else
+      return ERR_CONFIG_VALUE;
+    break;
+  }
+  default:
+    return ERR_INVALID_STATE;
+  }
+  return ERR_OK;
+}
+
+p_sim_error_t SimConfig::load(const char *path)
+{
+  if (NULL == path)
+    return ERR_NULL_PTR;
+  FILE *f = fopen(path, "r");
+  if (NULL == f)
+  {
+    fprintf(stderr, "%s: cannot open config file\n", path);
+    return ERR_CONFIG_FILE;
+  }
+  char line[CONFIG_LINE_MAX];
+  uint32_t line_no = 0;
+  p_sim_error_t res = ERR_OK;
+  while (ERR_OK == res && fgets(line, sizeof(line), f))
+  {
+    line_no++;
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+    char *s = trim(line);
+    if (*s == '\0')
+      continue;
+    char *eq = strchr(s, '=');
+    if (NULL == eq)
+    {
+      fprintf(stderr, "%s:%u: expected key = value\n", path, line_no);
+      res = ERR_CONFIG_VALUE;
+      break;
+    }
+    *eq = '\0';
+    char *key = trim(s);
+    char *value = trim(eq + 1);
+    res = this->set(key, value);
+    if (ERR_CONFIG_KEY == res)
+      fprintf(stderr, "%s:%u: unknown key '%s'\n", path, line_no, key);
+    else if (ERR_OK != res)
+      fprintf(stderr, "%s:%u: bad value '%s' for %s\n", path, line_no, value,
+              key);
+  }
+  fclose(f);
+  return res;
+}
+
+p_sim_error_t SimConfig::parse_args(int argc, char **argv,
+                                    std::vector<char *> *rest)
+{
+  if (NULL == rest)
+    return ERR_NULL_PTR;
+  for (int i = 1; i < argc; i++)
+  {
+    char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (!strcmp(arg, "--config"))
+    {
+      if (!has_value)
+      {
+        fprintf(stderr, "--config needs a file\n");
+        return ERR_CONFIG_VALUE;
+      }
+      p_sim_error_t res = this->load(argv[++i]);
+      if (ERR_OK != res)
+        return res;
+      continue;
+    }
+    if (strncmp(arg, "--", 2))
+    {
+      rest->push_back(arg);
+      continue;
+    }
+    // --key=value or --key value, for known keys only
+    const char *name = arg + 2;
+    const char *eq = strchr(name, '=');
+    const config_key_t *k =
+        find_key(name, eq ? (size_t)(eq - name) : strlen(name));
+    if (NULL == k)
+    {
+      rest->push_back(arg);
+      continue;
+    }
+    const char *value = NULL;
+    if (eq)
+      value = eq + 1;
+    else if (has_value)
+      value = argv[++i];
+    if (NULL == value || ERR_OK != this->set(k->name, value))
+    {
+      fprintf(stderr, "bad value for --%s\n", k->name);
+      return ERR_CONFIG_VALUE;
+    }
+  }
+  return ERR_OK;
+}
+
+p_sim_error_t SimConfig::validate() const
+{
+  const char *problem = NULL;
+  if (0 == this->n_particles)
+    problem = "particles must be > 0";
+  else if (!(this->radius_min > 0.0f) ||
+           !(this->radius_max >= this->radius_min))
+    problem = "need 0 < radius_min <= radius_max";
+  else if (!(this->radius_max < this->field_radius))
+    problem = "radius_max must be < field_radius";
+  else if (!(this->v0_max >= 0.0f))
+    problem = "v0_max must be >= 0";
+  else if (this->placement > PLACEMENT_MAX)
+    problem = "placement must be 0 (random), 1 (lattice) or 2 (poisson)";
+  else if (!(this->elastic_coeff >= 0.0f && this->elastic_coeff <= 1.0f))
+    problem = "elastic_coeff must be in [0, 1]";
+  else if (!(this->neighbor_skin >= 0.0f))
+    problem = "neighbor_skin must be >= 0";
+  else if (!(this->speed_colors.max > 0.0f))
+    problem = "speed_colors_max must be > 0";
+  else if (0 == this->tracer)
+    problem = "tracer must be >= 1";
+  else if (0 == this->window_size_x || 0 == this->window_size_y ||
+           !(this->framerate > 0.0f))
+    problem = "window size and framerate must be > 0";
+  else if (0 == this->steps_per_frame ||
+           this->steps_per_frame > STEPS_PER_FRAME_MAX)
+    problem = "steps_per_frame must be in [1, 4096]";
+  else if (0 == this->trajectory_every || 0 == this->trajectory_block)
+    problem = "trajectory_every and trajectory_block must be > 0";
+  else if (!(this->trajectory_pos_quantum > 0.0f) ||
+           !(this->trajectory_vel_quantum > 0.0f))
+    problem = "trajectory quanta must be > 0";
+  if (NULL == problem)
+    return ERR_OK;
+  fprintf(stderr, "invalid config: %s\n", problem);
+  return ERR_CONFIG_VALUE;
+}
+
+void SimConfig::print(FILE *out) const
+{
+  for (size_t k = 0; k < N_CONFIG_KEYS; k++)
+  {
+    const config_key_t *key = &CONFIG_KEYS[k];
+    const char *field = (const char *)this + key->offset;
+    switch (key->type)
+    {
+    case CONFIG_UINT:
+      fprintf(out, "%s = %u\n", key->name, *(const uint32_t *)field);
+      break;
+    case CONFIG_INT:
+      fprintf(out, "%s = %d\n", key->name, *(const int32_t *)field);
+      break;
+    case CONFIG_FLOAT:
+      fprintf(out, "%s = %.9g\n", key->name, *(const float *)field);
+      break;
+    case CONFIG_BOOL:
+      fprintf(out, "%s = %d\n", key->name, *(const bool *)field ? 1 : 0);
+      break;
+    }
+  }
+}
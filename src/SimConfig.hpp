@@ -0,0 +1,120 @@
+#ifndef __SIMCONFIG_HPP__
+#define __SIMCONFIG_HPP__
+
+#include "p_sim_error.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * @brief Speed tinting of particle colors: a particle's color is shifted by
+ * mod_* x (speed / max), speed capped at max.
+ */
+typedef struct
+{
+  bool enabled;
+  float max;
+  int32_t mod_r;
+  int32_t mod_g;
+  int32_t mod_b;
+} speed_colors_t;
+
+/*
+ * Initial particle placement (SimConfig::placement), see
+ * ParticleFieldCircular::init().
+ */
+#define PLACEMENT_RANDOM 0  // uniform polar coordinates, may overlap
+#define PLACEMENT_LATTICE 1 // hexagonal lattice clipped to the field
+#define PLACEMENT_POISSON 2 // Poisson disk sampling
+#define PLACEMENT_MAX PLACEMENT_POISSON
+
+/**
+ * @brief Run-time simulation parameters.
+ *
+ * Defaults come from `config.h`; any of them can be overridden from a config
+ * file (`key = value` lines, `#` comments) and from the command line
+ * (`--key=value` or `--key value`), later settings winning. Build-time
+ * switches (SIMD kernels, parallel windows, DEBUG, ...) stay in `config.h`.
+ */
+class SimConfig
+{
+public:
+  uint32_t n_particles;
+  uint32_t seed; // SimRandom seed for particle generation
+  float radius_min; // generated particle radius range
+  float radius_max;
+  float v0_max;        // generated initial speed (per axis)
+  uint32_t placement;  // initial placement (PLACEMENT_*)
+  float elastic_coeff; // coefficient of restitution (1 = elastic)
+  bool specialize;     // use the uniform radius / elastic fast paths
+  bool calendar_queue; // calendar event queue instead of the binary heap
+  bool neighbor_lists; // Verlet neighbor lists instead of grid queries
+  float neighbor_skin; // neighbor list margin (pixels)
+  float field_center_x;
+  float field_center_y;
+  float field_radius;
+  speed_colors_t speed_colors;
+  uint32_t tracer; // trail length in frames, counting the particle (1 = off)
+  int32_t tracer_mod_r;
+  int32_t tracer_mod_g;
+  int32_t tracer_mod_b;
+  uint32_t window_size_x;
+  uint32_t window_size_y;
+  float framerate;
+  uint32_t steps_per_frame; // timesteps computed per drawn frame
+  bool fast_forward;        // frames not paced to the framerate
+  uint32_t stats_every; // timesteps between stats dumps (0 = never)
+  uint32_t trajectory_every; // timesteps between trajectory frames
+  uint32_t trajectory_block; // frames per compressed block
+  float trajectory_pos_quantum; // position resolution (pixels)
+  float trajectory_vel_quantum; // velocity resolution (pixels per timestep)
+
+  /** @brief Config with the `config.h` defaults. */
+  SimConfig();
+
+  /**
+   * @brief Sets one parameter from its text value.
+   * @param key parameter name (as in the config file, e.g. "radius_max")
+   * @param value text value
+   * @return ERR_OK if successful, ERR_CONFIG_KEY for an unknown key,
+   * ERR_CONFIG_VALUE if the value does not parse
+   */
+  p_sim_error_t set(const char *key, const char *value);
+
+  /**
+   * @brief Applies every `key = value` line of a config file.
+   * @param path config file path
+   * @return ERR_OK if successful, ERR_CONFIG_FILE if it cannot be read, or
+   * the error of the first bad line (reported on stderr)
+   */
+  p_sim_error_t load(const char *path);
+
+  /**
+   * @brief Applies command line overrides, in order: `--config FILE` loads a
+   * file, `--key=value` and `--key value` set a known parameter.
+   * @param argc argument count
+   * @param argv arguments (argv[0] is skipped)
+   * @param rest where to append the arguments that are not config settings
+   * (positionals and other options), for the caller to handle
+   * @return ERR_OK if successful, otherwise the first error (reported on
+   * stderr)
+   */
+  p_sim_error_t parse_args(int argc, char **argv, std::vector<char *> *rest);
+
+  /**
+   * @brief Checks that the parameters describe a runnable sim.
+   * @return ERR_OK if so, ERR_CONFIG_VALUE if not (reported on stderr)
+   */
+  p_sim_error_t validate() const;
+
+  /** @brief Whether particle collisions lose no energy. */
+  bool is_elastic() const { return this->elastic_coeff == 1.0f; }
+
+  /**
+   * @brief Writes every parameter in config file format.
+   * @param out output stream
+   */
+  void print(FILE *out) const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __SIMRANDOM_HPP__
+#define __SIMRANDOM_HPP__
+
+#include <stdint.h>
+
+/**
+ * @brief Small random number generator (PCG32) for particle generation.
+ *
+ * Unlike rand(), its whole state is two integers, so it can be saved in a
+ * checkpoint and restored exactly.
+ *
+ * For drawing in parallel, `next_key()` takes a key from the sequence and
+ * `at()` is a counter-based generator (Squares): the n-th number of a key is
+ * a pure function of both, so every particle can draw from its own counters
+ * on any thread and the result does not depend on the thread count.
+ */
+class SimRandom
+{
+public:
+  uint64_t state;
+  uint64_t inc; // stream selector (odd)
+
+  SimRandom() { this->seed(1); }
+
+  /** @brief Restarts the sequence from a seed. */
+  void seed(uint64_t seed)
+  {
+    this->state = 0;
+    this->inc = (0xda3e39cb94b95bdbULL << 1) | 1;
+    this->next();
+    this->state += seed;
+    this->next();
+  }
+
+  /** @brief Next 32 random bits. */
+  uint32_t next()
+  {
+    uint64_t old = this->state;
+    this->state = old * 6364136223846793005ULL + this->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+  }
+
+  /** @brief Uniform float in [min, max). */
+  float uniform(float min, float max)
+  {
+    return to_uniform(this->next(), min, max);
+  }
+
+  /** @brief Key for `at()`, from the next 64 bits of the sequence. */
+  uint64_t next_key()
+  {
+    uint64_t k = ((uint64_t)this->next() << 32) | this->next();
+    // SplitMix64 finalizer: Squares wants keys with well mixed bits
+    k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    k = (k ^ (k >> 27)) * 0x94d049bb133111ebULL;
+    return (k ^ (k >> 31)) | 1;
+  }
+
+  /** @brief 32 random bits number `counter` of the stream `key`. */
+  static uint32_t at(uint64_t key, uint64_t counter)
+  {
+    uint64_t x = counter * key;
+    uint64_t y = x;
+    uint64_t z = y + key;
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    x = x * x + z;
+    x = (x >> 32) | (x << 32);
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    return (uint32_t)((x * x + z) >> 32);
+  }
+
+  /** @brief Uniform float in [min, max), number `counter` of `key`. */
+  static float uniform_at(uint64_t key, uint64_t counter, float min,
+                          float max)
+  {
+    return to_uniform(at(key, counter), min, max);
+  }
+
+private:
+  static float to_uniform(uint32_t bits, float min, float max)
+  {
+    float u = (float)(bits >> 8) * (1.0f / 16777216.0f);
+    return min + u * (max - min);
+  }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "SimWorker.hpp"
+
+SimWorker::SimWorker(ParticleSim *sim)
+{
+  this->sim = sim;
+  this->n_steps = 0;
+  this->posted = false;
+  this->outstanding = false;
+  this->closing = false;
+  this->result = ERR_OK;
+}
+
+SimWorker::~SimWorker() { this->stop(); }
+
+p_sim_error_t SimWorker::start()
+{
+  if (NULL == this->sim)
+    return ERR_NULL_PTR;
+  if (this->thread.joinable())
+    return ERR_INVALID_STATE;
+  this->posted = false;
+  this->outstanding = false;
+  this->closing = false;
+  this->result = ERR_OK;
+  this->thread = std::thread(&SimWorker::run, this);
+  return ERR_OK;
+}
+
+p_sim_error_t SimWorker::request(uint32_t n_steps)
+{
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!this->thread.joinable() || this->outstanding)
+      return ERR_INVALID_STATE;
+    this->n_steps = n_steps;
+    this->posted = true;
+    this->outstanding = true;
+  }
+  this->wake.notify_all();
+  return ERR_OK;
+}
+
+p_sim_error_t SimWorker::wait()
+{
+  std::unique_lock<std::mutex> guard(this->lock);
+  if (!this->thread.joinable() || !this->outstanding)
+    return ERR_INVALID_STATE;
+  this->wake.wait(guard, [this] { return !this->posted; });
+  this->outstanding = false;
+  return this->result;
+}
+
+void SimWorker::run()
+{
+  while (true)
+  {
+    uint32_t n_steps;
+    {
+      std::unique_lock<std::mutex> guard(this->lock);
+      this->wake.wait(guard, [this] { return this->posted || this->closing; });
+      if (!this->posted)
+        return; // closing, nothing left
+      n_steps = this->n_steps;
+    }
+
+    p_sim_error_t res = this->sim->step(n_steps);
+
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->result = res;
+      this->posted = false;
+    }
+    this->wake.notify_all();
+  }
+}
+
+void SimWorker::stop()
+{
+  if (!this->thread.joinable())
+    return;
+  {
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->wake.wait(guard, [this] { return !this->posted; });
+    this->closing = true;
+  }
+  this->wake.notify_all();
+  this->thread.join();
+}
@@ -0,0 +1,78 @@
+#ifndef __SIMWORKER_HPP__
+#define __SIMWORKER_HPP__
+
+#include "ParticleSim.hpp"
+#include "p_sim_error.h"
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+/**
+ * @brief Runs a sim's timesteps on one persistent thread, so that a frame can
+ * draw the last published snapshot while the next timesteps are computed.
+ *
+ * Requests go to the thread through a single slot: `request()` posts a
+ * number of timesteps, `wait()` takes their result, and a frame does exactly
+ * one of each. The thread lives from `start()` to `stop()`, so with OpenMP it
+ * stays the master of one thread team for the whole run instead of a team
+ * being built and torn down every frame.
+ */
+class SimWorker
+{
+private:
+  ParticleSim *sim;
+  uint32_t n_steps;      // timesteps of the posted request
+  bool posted;           // a request is waiting for (or running on) the thread
+  bool outstanding;      // a request was posted and not waited for yet
+  bool closing;
+  p_sim_error_t result;  // result of the last finished request
+  std::mutex lock;       // guards n_steps, posted, outstanding, closing, result
+  std::condition_variable wake;
+  std::thread thread;
+
+  /**
+   * @brief Worker thread: runs requests until stopped.
+   */
+  void run();
+
+public:
+  /**
+   * @brief SimWorker constructor (stopped).
+   * @param sim sim to advance (must outlive the worker's thread)
+   */
+  SimWorker(ParticleSim *sim);
+
+  ~SimWorker();
+
+  /**
+   * @brief Starts the worker thread.
+   * @return ERR_OK if successful, ERR_NULL_PTR if there is no sim,
+   * ERR_INVALID_STATE if already started
+   */
+  p_sim_error_t start();
+
+  /**
+   * @brief Posts a request to advance the sim (see `ParticleSim::step()`).
+   * Returns at once; the sim must not be touched until `wait()`.
+   * @param n_steps number of timesteps to run
+   * @return ERR_OK if successful, ERR_INVALID_STATE if not started or the
+   * previous request was not waited for
+   */
+  p_sim_error_t request(uint32_t n_steps);
+
+  /**
+   * @brief Waits for the posted request to finish.
+   * @return its result, or ERR_INVALID_STATE if not started or no request
+   * was posted since the last `wait()`
+   */
+  p_sim_error_t wait();
+
+  /**
+   * @brief Finishes the posted request (if any) and stops the worker thread.
+   * Does nothing if not started.
+   */
+  void stop();
+};
+
+#endif
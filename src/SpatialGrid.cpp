@@ -0,0 +1,157 @@
+#include "SpatialGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Upper bound on cells per axis, in case a particle wanders far off the field
+#define SPATIAL_GRID_MAX_DIM 4096
+// Upper bound on cells per binned particle (coarser cells beyond it)
+#define SPATIAL_GRID_CELLS_PER_PARTICLE 4
+#define SPATIAL_GRID_COARSEN 1.25f // cell size factor while over the bound
+
+SpatialGrid::SpatialGrid()
+{
+  this->origin = sf::Vector2f(0.0f, 0.0f);
+  this->cell_size = 1.0f;
+  this->inv_cell_size = 1.0f;
+  this->n_cols = 0;
+  this->n_rows = 0;
+}
+
+int32_t SpatialGrid::col_of(float x) const
+{
+  float c = std::floor((x - this->origin.x) * this->inv_cell_size);
+  if (!(c >= 0.0f)) // also catches NaN
+    return 0;
+  if (c >= (float)(this->n_cols - 1))
+    return this->n_cols - 1;
+  return (int32_t)c;
+}
+
+int32_t SpatialGrid::row_of(float y) const
+{
+  float r = std::floor((y - this->origin.y) * this->inv_cell_size);
+  if (!(r >= 0.0f))
+    return 0;
+  if (r >= (float)(this->n_rows - 1))
+    return this->n_rows - 1;
+  return (int32_t)r;
+}
+
+uint32_t SpatialGrid::cell_index(sf::Vector2f position) const
+{
+  return (uint32_t)(this->row_of(position.y) * this->n_cols +
+                    this->col_of(position.x));
+}
+
+void SpatialGrid::insert(uint32_t idx, uint32_t cell)
+{
+  this->cell_of[idx] = cell;
+  this->slot_of[idx] = (uint32_t)this->cells[cell].size();
+  this->cells[cell].push_back(idx);
+}
+
+void SpatialGrid::remove(uint32_t idx)
+{
+  std::vector<uint32_t> &cell = this->cells[this->cell_of[idx]];
+  uint32_t slot = this->slot_of[idx];
+  uint32_t last = cell.back();
+  cell[slot] = last;
+  this->slot_of[last] = slot;
+  cell.pop_back();
+}
+
+p_sim_error_t SpatialGrid::build(const ParticleStore &particles,
+                                 float cell_size)
+{
+  return this->build(particles, cell_size, NULL, particles.size());
+}
+
+p_sim_error_t SpatialGrid::build(const ParticleStore &particles,
+                                 float cell_size,
+                                 const std::vector<particle_t> &subset)
+{
+  return this->build(particles, cell_size, subset.data(), subset.size());
+}
+
+// subset == NULL bins every particle (n_subset of them)
+p_sim_error_t SpatialGrid::build(const ParticleStore &particles,
+                                 float cell_size, const particle_t *subset,
+                                 size_t n_subset)
+{
+  if (!(cell_size > 0.0f))
+    return ERR_INVALID_STATE;
+  size_t n = particles.size();
+  if (n == 0 || n_subset == 0)
+    return ERR_NO_DATA;
+
+  sf::Vector2f lo = particles.get_position(subset ? subset[0] : 0);
+  sf::Vector2f hi = lo;
+  for (size_t k = 1; k < n_subset; k++)
+  {
+    particle_t i = subset ? subset[k] : (particle_t)k;
+    lo.x = std::min(lo.x, particles.x[i]);
+    lo.y = std::min(lo.y, particles.y[i]);
+    hi.x = std::max(hi.x, particles.x[i]);
+    hi.y = std::max(hi.y, particles.y[i]);
+  }
+  float extent = std::max(hi.x - lo.x, hi.y - lo.y);
+  if (extent / cell_size > SPATIAL_GRID_MAX_DIM)
+    cell_size = extent / SPATIAL_GRID_MAX_DIM;
+
+  // A few particles spread wide would get far more cells than particles:
+  // coarser cells keep the grid (and clearing it every build) O(n_subset)
+  size_t max_cells = SPATIAL_GRID_CELLS_PER_PARTICLE * n_subset;
+  while (true)
+  {
+    this->inv_cell_size = 1.0f / cell_size;
+    this->n_cols = (int32_t)((hi.x - lo.x) * this->inv_cell_size) + 1;
+    this->n_rows = (int32_t)((hi.y - lo.y) * this->inv_cell_size) + 1;
+    if ((size_t)this->n_cols * (size_t)this->n_rows <= max_cells)
+      break;
+    cell_size *= SPATIAL_GRID_COARSEN;
+  }
+  this->origin = lo;
+  this->cell_size = cell_size;
+
+  size_t n_cells = (size_t)this->n_cols * (size_t)this->n_rows;
+  if (this->cells.size() < n_cells)
+    this->cells.resize(n_cells);
+  for (size_t c = 0; c < n_cells; c++)
+    this->cells[c].clear();
+  this->cell_of.resize(n);
+  this->slot_of.resize(n);
+
+  for (size_t k = 0; k < n_subset; k++)
+  {
+    particle_t i = subset ? subset[k] : (particle_t)k;
+    this->insert(i, this->cell_index(particles.get_position(i)));
+  }
+  return ERR_OK;
+}
+
+void SpatialGrid::move(particle_t idx, sf::Vector2f position)
+{
+  uint32_t cell = this->cell_index(position);
+  if (cell == this->cell_of[idx])
+    return;
+  this->remove(idx);
+  this->insert(idx, cell);
+}
+
+void SpatialGrid::query(sf::Vector2f lo, sf::Vector2f hi,
+                        std::vector<uint32_t> *out) const
+{
+  int32_t c0 = this->col_of(lo.x);
+  int32_t c1 = this->col_of(hi.x);
+  int32_t r0 = this->row_of(lo.y);
+  int32_t r1 = this->row_of(hi.y);
+  for (int32_t r = r0; r <= r1; r++)
+  {
+    for (int32_t c = c0; c <= c1; c++)
+    {
+      const std::vector<uint32_t> &cell = this->cells[r * this->n_cols + c];
+      out->insert(out->end(), cell.begin(), cell.end());
+    }
+  }
+}
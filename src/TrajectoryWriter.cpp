@@ -0,0 +1,253 @@
+#include "TrajectoryWriter.hpp"
+
+#include <cmath>
+#include <string.h>
+#include <zlib.h>
+
+#define TRAJECTORY_COMPONENTS 4 // x, y, vx, vy
+#define VARINT_MAX_BYTES 10      // 64 bits, 7 per byte
+
+/**
+ * Static helper: writes an unsigned LEB128 varint, returns the next byte.
+ */
+static uint8_t *put_varint(uint8_t *out, uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    *out++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *out++ = (uint8_t)v;
+  return out;
+}
+
+/**
+ * Static helper: writes a signed value as a zigzag varint (small magnitudes
+ * of either sign take few bytes), returns the next byte.
+ */
+static uint8_t *put_zigzag(uint8_t *out, int64_t v)
+{
+  return put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+/**
+ * Static helper: value / quantum rounded to the nearest step, clamped to
+ * 32 bits.
+ */
+static int32_t quantize(float value, float scale)
+{
+  double q = std::nearbyint((double)value * scale);
+  if (!(q > INT32_MIN)) // also NaN
+    return INT32_MIN;
+  if (q > INT32_MAX)
+    return INT32_MAX;
+  return (int32_t)q;
+}
+
+TrajectoryWriter::TrajectoryWriter(const SimConfig &config)
+{
+  this->file = NULL;
+  this->n_particles = 0;
+  this->every = config.trajectory_every > 0 ? config.trajectory_every : 1;
+  this->block_frames = config.trajectory_block > 0 ? config.trajectory_block
+                                                   : 1;
+  this->header = trajectory_header_t();
+  memcpy(this->header.magic, TRAJECTORY_MAGIC, sizeof(this->header.magic));
+  this->header.version = TRAJECTORY_VERSION;
+  this->header.byte_order = TRAJECTORY_BYTE_ORDER;
+  this->header.every = this->every;
+  this->header.pos_quantum = config.trajectory_pos_quantum;
+  this->header.vel_quantum = config.trajectory_vel_quantum;
+  this->header.field_center_x = config.field_center_x;
+  this->header.field_center_y = config.field_center_y;
+  this->header.field_radius = config.field_radius;
+  this->fill = trajectory_block_t();
+  this->slot = trajectory_block_t();
+  this->slot_full = false;
+  this->closing = false;
+  this->failed = false;
+  this->stats = trajectory_stats_t();
+}
+
+TrajectoryWriter::~TrajectoryWriter() { this->close(); }
+
+p_sim_error_t TrajectoryWriter::open(const char *path, uint32_t n_particles)
+{
+  if (NULL == path)
+    return ERR_NULL_PTR;
+  if (NULL != this->file)
+    return ERR_INVALID_STATE;
+  this->file = fopen(path, "wb");
+  if (NULL == this->file)
+    return ERR_IO;
+  this->n_particles = n_particles;
+  this->header.n_particles = n_particles;
+  if (fwrite(&this->header, sizeof(this->header), 1, this->file) != 1)
+  {
+    fclose(this->file);
+    this->file = NULL;
+    return ERR_IO;
+  }
+  this->stats = trajectory_stats_t();
+  this->stats.file_bytes = sizeof(this->header);
+  this->last.assign((size_t)n_particles * TRAJECTORY_COMPONENTS, 0);
+  this->fill.data.clear();
+  this->fill.n_frames = 0;
+  this->slot_full = false;
+  this->closing = false;
+  this->failed = false;
+  this->thread = std::thread(&TrajectoryWriter::run, this);
+  return ERR_OK;
+}
+
+p_sim_error_t TrajectoryWriter::record(const ParticleStore *ps,
+                                       uint64_t timestep)
+{
+  if (NULL == ps)
+    return ERR_NULL_PTR;
+  if (NULL == this->file || ps->size() != this->n_particles)
+    return ERR_INVALID_STATE;
+  if (timestep % this->every)
+    return ERR_OK;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->failed)
+      return ERR_IO;
+  }
+
+  trajectory_block_t &b = this->fill;
+  if (0 == b.n_frames)
+    b.first_timestep = timestep;
+  size_t n = this->n_particles;
+  size_t used = b.data.size();
+  b.data.resize(used + (1 + n * TRAJECTORY_COMPONENTS) * VARINT_MAX_BYTES);
+  uint8_t *out = b.data.data() + used;
+  out = put_varint(out, timestep - b.first_timestep);
+  const float *values[TRAJECTORY_COMPONENTS] = {ps->x.data(), ps->y.data(),
+                                                ps->vx.data(), ps->vy.data()};
+  const float offset[TRAJECTORY_COMPONENTS] = {this->header.field_center_x,
+                                               this->header.field_center_y,
+                                               0.0f, 0.0f};
+  const float pos_scale = 1.0f / this->header.pos_quantum;
+  const float vel_scale = 1.0f / this->header.vel_quantum;
+  // Positions are predicted from the previous frame's position and velocity
+  // (exact for particles that did not collide since), velocities from the
+  // previous frame's velocity
+  const double drift_scale = (double)this->header.vel_quantum * this->every /
+                             this->header.pos_quantum;
+  for (size_t c = 0; c < TRAJECTORY_COMPONENTS; c++)
+  {
+    float scale = c < 2 ? pos_scale : vel_scale;
+    int32_t *last = &this->last[c * n];
+    const int32_t *last_v = c < 2 ? &this->last[(c + 2) * n] : NULL;
+    for (size_t i = 0; i < n; i++)
+    {
+      int32_t q = quantize(values[c][i] - offset[c], scale);
+      int64_t predicted = last[i];
+      if (last_v)
+        predicted += (int64_t)std::nearbyint(last_v[i] * drift_scale);
+      out = put_zigzag(out, (int64_t)q - predicted);
+      last[i] = q;
+    }
+  }
+  b.data.resize((size_t)(out - b.data.data()));
+  b.n_frames++;
+  this->stats.frames++;
+  this->stats.raw_bytes += (uint64_t)n * TRAJECTORY_COMPONENTS * sizeof(float);
+  if (b.n_frames == this->block_frames)
+    this->hand_off(false);
+  return ERR_OK;
+}
+
+void TrajectoryWriter::hand_off(bool wait)
+{
+  {
+    std::unique_lock<std::mutex> guard(this->lock);
+    if (wait)
+      this->wake.wait(guard, [this] { return !this->slot_full; });
+    if (this->slot_full)
+      this->stats.blocks_dropped++;
+    else
+    {
+      std::swap(this->fill, this->slot);
+      this->slot_full = true;
+    }
+  }
+  this->wake.notify_all();
+  // The next block starts from zero, so that it decodes on its own
+  this->fill.data.clear();
+  this->fill.n_frames = 0;
+  std::fill(this->last.begin(), this->last.end(), 0);
+}
+
+void TrajectoryWriter::run()
+{
+  trajectory_block_t work = trajectory_block_t();
+  std::vector<uint8_t> compressed;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> guard(this->lock);
+      this->wake.wait(guard,
+                      [this] { return this->slot_full || this->closing; });
+      if (!this->slot_full)
+        return; // closing, nothing left
+      std::swap(work, this->slot);
+      this->slot_full = false;
+    }
+    this->wake.notify_all();
+
+    uLongf size = compressBound((uLong)work.data.size());
+    compressed.resize(size);
+    bool ok = Z_OK == compress2(compressed.data(), &size, work.data.data(),
+                                (uLong)work.data.size(), Z_BEST_SPEED);
+    trajectory_block_header_t block = trajectory_block_header_t();
+    block.first_timestep = work.first_timestep;
+    block.n_frames = work.n_frames;
+    block.raw_size = (uint32_t)work.data.size();
+    block.compressed_size = (uint32_t)size;
+    ok = ok && fwrite(&block, sizeof(block), 1, this->file) == 1 &&
+         fwrite(compressed.data(), 1, size, this->file) == size;
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!ok)
+      this->failed = true;
+    this->stats.blocks++;
+    this->stats.file_bytes += sizeof(block) + size;
+  }
+}
+
+p_sim_error_t TrajectoryWriter::close()
+{
+  if (NULL == this->file)
+    return ERR_OK;
+  if (this->fill.n_frames > 0)
+    this->hand_off(true);
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->closing = true;
+  }
+  this->wake.notify_all();
+  this->thread.join();
+  bool ok = !this->failed;
+  ok = (0 == fclose(this->file)) && ok;
+  this->file = NULL;
+  return ok ? ERR_OK : ERR_IO;
+}
+
+trajectory_stats_t TrajectoryWriter::get_stats()
+{
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->stats;
+}
+
+void TrajectoryWriter::print_stats(FILE *out)
+{
+  trajectory_stats_t t = this->get_stats();
+  fprintf(out,
+          "trajectory:     %lu frames, %lu bytes (%0.1f%% of raw), "
+          "%lu blocks dropped\n",
+          (unsigned long)t.frames, (unsigned long)t.file_bytes,
+          t.raw_bytes ? 100.0 * t.file_bytes / t.raw_bytes : 0.0,
+          (unsigned long)t.blocks_dropped);
+}
@@ -0,0 +1,170 @@
+#ifndef __TRAJECTORYWRITER_HPP__
+#define __TRAJECTORYWRITER_HPP__
+
+#include "ParticleStore.hpp"
+#include "SimConfig.hpp"
+#include "p_sim_error.h"
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#define TRAJECTORY_MAGIC "PSIMTRAJ"
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_BYTE_ORDER 0x01020304u
+
+/**
+ * @brief Trajectory file header (version 1).
+ */
+typedef struct
+{
+  char magic[8];       // TRAJECTORY_MAGIC, not NUL terminated
+  uint32_t version;    // TRAJECTORY_VERSION
+  uint32_t byte_order; // TRAJECTORY_BYTE_ORDER as written by the writer
+  uint32_t n_particles;
+  uint32_t every;      // timesteps between two frames
+  float pos_quantum;   // position step of the quantized values
+  float vel_quantum;   // velocity step of the quantized values
+  float field_center_x; // positions are relative to the field center
+  float field_center_y;
+  float field_radius;
+  uint32_t reserved;
+} trajectory_header_t;
+
+/**
+ * @brief Header of one compressed block of frames.
+ */
+typedef struct
+{
+  uint64_t first_timestep;  // timestep of the block's first frame
+  uint32_t n_frames;
+  uint32_t raw_size;        // encoded frames, before compression
+  uint32_t compressed_size; // bytes following this header
+  uint32_t reserved;
+} trajectory_block_header_t;
+
+/**
+ * @brief Frames encoded by the sim thread, not yet compressed.
+ */
+typedef struct
+{
+  std::vector<uint8_t> data;
+  uint32_t n_frames;
+  uint64_t first_timestep;
+} trajectory_block_t;
+
+/**
+ * @brief Totals of a trajectory (final once the writer is closed).
+ */
+typedef struct
+{
+  uint64_t frames;         // frames recorded (including dropped ones)
+  uint64_t blocks;         // blocks written
+  uint64_t blocks_dropped; // blocks dropped because the writer was behind
+  uint64_t raw_bytes;      // size of the frames as float x, y, vx, vy
+  uint64_t file_bytes;     // size of the file
+} trajectory_stats_t;
+
+/**
+ * @brief Records particle positions and velocities every few timesteps to a
+ * compressed trajectory file, without the sim ever waiting on the disk.
+ *
+ * Each frame is quantized (positions relative to the field center, to
+ * `trajectory_pos_quantum`; velocities to `trajectory_vel_quantum`) and
+ * stored as the difference from a prediction, as zigzag varints, component
+ * by component: the frame's timestep offset in its block, then every
+ * particle's x, then y, vx and vy. A velocity is predicted to be the previous
+ * frame's; a position, the previous frame's plus the previous velocity times
+ * `every` (in position steps, rounded half to even as a double), which is
+ * exact for particles that have not collided since. `trajectory_block`
+ * frames make a block, whose first frame is predicted from zero so that
+ * blocks decode on their own.
+ *
+ * Full blocks are handed to a writer thread through a single slot (double
+ * buffering: the sim fills one block while the thread compresses and writes
+ * the other, with zlib). If the thread is still busy with the previous
+ * block, the new one is dropped and counted rather than waited for.
+ *
+ * File: `trajectory_header_t`, then blocks (`trajectory_block_header_t` and
+ * the zlib stream), in the writer's native byte order.
+ */
+class TrajectoryWriter
+{
+private:
+  FILE *file;
+  uint32_t n_particles;
+  uint32_t every;
+  uint32_t block_frames;
+  trajectory_header_t header;
+  std::vector<int32_t> last; // previous frame's quantized values
+  trajectory_block_t fill;   // block being encoded (sim thread)
+  trajectory_block_t slot;   // block handed to the writer thread
+  bool slot_full;
+  bool closing;
+  bool failed;               // a write failed (set by the writer thread)
+  std::mutex lock;           // guards slot, slot_full, closing, failed
+  std::condition_variable wake;
+  std::thread thread;
+  trajectory_stats_t stats;
+
+  /**
+   * @brief Hands the filled block to the writer thread and starts a new one.
+   * @param wait wait for the slot if the thread is busy (instead of dropping
+   * the block)
+   */
+  void hand_off(bool wait);
+
+  /**
+   * @brief Writer thread: compresses and writes blocks until closed.
+   */
+  void run();
+
+public:
+  /**
+   * @brief TrajectoryWriter constructor (closed).
+   * @param config sim config (frame interval, block size, quanta, field)
+   */
+  TrajectoryWriter(const SimConfig &config);
+
+  ~TrajectoryWriter();
+
+  /**
+   * @brief Creates the trajectory file and starts the writer thread.
+   * @param path trajectory file path
+   * @param n_particles particles per frame
+   * @return ERR_OK if successful, ERR_INVALID_STATE if already open, ERR_IO
+   * if the file cannot be created
+   */
+  p_sim_error_t open(const char *path, uint32_t n_particles);
+
+  /**
+   * @brief Records the particles after a timestep, if it is a frame's
+   * (every `trajectory_every` timesteps). Never blocks on the writer thread.
+   * @param ps particles
+   * @param timestep timesteps run so far
+   * @return ERR_OK if successful, ERR_INVALID_STATE if not open or the
+   * particle count changed, ERR_IO if the writer thread failed
+   */
+  p_sim_error_t record(const ParticleStore *ps, uint64_t timestep);
+
+  /**
+   * @brief Writes the last partial block, stops the writer thread and closes
+   * the file. Does nothing if not open.
+   * @return ERR_OK if successful, ERR_IO if any write failed
+   */
+  p_sim_error_t close();
+
+  /** @brief Trajectory totals, see `trajectory_stats_t`. */
+  trajectory_stats_t get_stats();
+
+  /**
+   * @brief Writes `get_stats()` as one line (frames, file size against raw,
+   * blocks dropped).
+   * @param out output stream
+   */
+  void print_stats(FILE *out);
+};
+
+#endif
@@ -1,29 +1,94 @@
 #ifndef __PROJECTCONFIG_H__
 #define __PROJECTCONFIG_H__
 
+/* Options marked (run-time) are only the defaults of SimConfig, and can be
+ * overridden from a config file or the command line without rebuilding. */
+
 #define PARTICLE_DISABLE_DISAPPEAR 0
 #define PARTICLE_DISABLE_STOP 1
 
-/* Resolution Options */
+/* Resolution Options (run-time) */
 #define FRAMERATE 60.0f
 #define WINDOW_SIZE_X 1000
 #define WINDOW_SIZE_Y 1000
+/* Timesteps computed per drawn frame, and FAST_FORWARD 1 to not pace frames
+ * to FRAMERATE (run-time; +/- and F change them live in the window) */
+#define STEPS_PER_FRAME 1
+#define STEPS_PER_FRAME_MAX 4096
+#define FAST_FORWARD 0
 
 /* Nice Consts for Floating Point ops */
 #define EPS 1e-8f
 #define N_EPS -1e-6f
 
-/* Initial speed max/min */
+/* Initial speed max/min (run-time) */
 #define V0_MAX 7.0f
 
-/* Sim options */
+/* Sim options (run-time, except PARTICLE_COLOR) */
 #define PARTICLE_RADIUS_MIN 2.f
 #define PARTICLE_RADIUS_MAX 2.f
 #define PARTICLE_COLOR sf::Color::White
 #define PARTICLE_QUANTITY 1000
 #define PARTICLE_ELASTIC_COEFF 1.0f
+/* Initial placement: 0 random (may overlap), 1 hexagonal lattice, 2 Poisson
+ * disk sampling (see PLACEMENT_* in SimConfig.hpp) */
+#define PARTICLE_PLACEMENT 0
+/* Use the collision code specialized for equal particles and for elastic
+ * collisions when they apply (set to 0 to always use the general code) */
+#define PARTICLE_SPECIALIZE 1
+
+/* Use the SIMD time of collision kernels (SSE2/AVX2/AVX-512, picked at run
+ * time), for particle pairs and for particles against the field edge. Set to
+ * 0 to always use the scalar kernels. */
+#define COLLISION_KERNEL_SIMD 1
+
+/* Edge collisions are detected at the start of a timestep in batches of
+ * EDGE_BATCH consecutive particles, a batch being a thread's unit of work */
+#define EDGE_BATCH 1024
+
+/* Event queue (run-time): SIM_CALENDAR_QUEUE 0 uses a binary heap, 1 a
+ * calendar queue with about CALENDAR_BUCKET_EVENTS events per time bucket
+ * (CALENDAR_BUCKETS_MIN to CALENDAR_BUCKETS_MAX buckets, powers of two) */
+#define SIM_CALENDAR_QUEUE 0
+#define CALENDAR_BUCKET_EVENTS 2
+#define CALENDAR_BUCKETS_MIN 16
+#define CALENDAR_BUCKETS_MAX (1 << 22)
+
+/* Verlet neighbor lists (run-time, off by default): each particle lists the
+ * particles it could reach within a timestep, plus NEIGHBOR_SKIN pixels, and
+ * detection iterates its list instead of querying the grid. The lists are
+ * kept across timesteps until a particle may get more than half the reach
+ * away from where they were built. They only pay off when particles move
+ * much less than the skin per timestep. */
+#define NEIGHBOR_LISTS 0
+#define NEIGHBOR_SKIN 1.0f
 
-/* Tracers (to turn on, set PARTICLE_TRACER > 1) */
+/* Parallel event processing (OpenMP builds): the field is cut into one strip
+ * per thread, and strips process their own events concurrently in windows of
+ * up to 1 / PARALLEL_EVENT_WINDOWS timestep (a window in which strips
+ * interact is redone serially, and the next windows get shorter, down to
+ * 1 / PARALLEL_EVENT_WINDOWS_MAX). Each strip needs at least
+ * PARALLEL_EVENT_MIN_PARTICLES particles. Set PARALLEL_EVENT_WINDOWS to 0 to
+ * always process events serially. */
+#define PARALLEL_EVENT_WINDOWS 8
+#define PARALLEL_EVENT_WINDOWS_MAX 1024
+#define PARALLEL_EVENT_MIN_PARTICLES 256
+
+/* A timestep gives up on windows, and finishes serially, when a window of
+ * the shortest length still rolls back or when more than half of its first
+ * PARALLEL_EVENT_WINDOWS (or more) windows did. The next timesteps then run
+ * serially before windows are tried again: one after the first such
+ * timestep, twice as many after each consecutive one, up to
+ * PARALLEL_EVENT_BACKOFF_MAX. */
+#define PARALLEL_EVENT_BACKOFF_MAX 64
+
+/* Particle rendering: circles get about one segment per RENDER_SEGMENT_LENGTH
+ * pixels of on-screen circumference, within [RENDER_SEGMENTS_MIN, _MAX] */
+#define RENDER_SEGMENT_LENGTH 3.0f
+#define RENDER_SEGMENTS_MIN 8
+#define RENDER_SEGMENTS_MAX 100
+
+/* Tracers (to turn on, set PARTICLE_TRACER > 1) (run-time) */
 /* Optionally, can also modulate tracer colors (may conflict with speed
  * coloring) */
 #define PARTICLE_TRACER 1
@@ -31,19 +96,32 @@
 #define PARTICLE_TRACER_MOD_G 0
 #define PARTICLE_TRACER_MOD_B 0
 
-/* Field settings */
+/* Field settings (run-time, except the outline thickness) */
 #define PARTICLE_FIELD_CENTER_X 500.0f
 #define PARTICLE_FIELD_CENTER_Y 500.0f
 #define PARTICLE_FIELD_OUTLINE_THICKNESS 1.0f
 #define PARTICLE_FIELD_RADIUS 300.0f
 
-/* Color particles based on speed (unsure how tracers will play with this) */
+/* Color particles based on speed (unsure how tracers will play with this)
+ * (run-time) */
 #define PARTICLE_SPEED_COLORS 1
 #define PARTICLE_SPEED_COLORS_MAX 20.0f
 #define PARTICLE_SPEED_COLOR_MOD_R 0
 #define PARTICLE_SPEED_COLOR_MOD_G -255
 #define PARTICLE_SPEED_COLOR_MOD_B -255
 
+/* Print the sim's performance stats to stderr every SIM_STATS_EVERY
+ * timesteps (run-time, 0 = never) */
+#define SIM_STATS_EVERY 0
+
+/* Trajectory output (run-time): a frame every TRAJECTORY_EVERY timesteps,
+ * TRAJECTORY_BLOCK frames per compressed block, positions and velocities
+ * rounded to multiples of the quanta (pixels, pixels per timestep) */
+#define TRAJECTORY_EVERY 1
+#define TRAJECTORY_BLOCK 16
+#define TRAJECTORY_POS_QUANTUM (1.0f / 256.0f)
+#define TRAJECTORY_VEL_QUANTUM (1.0f / 4096.0f)
+
 // #define DEBUG 1
 
 #endif
@@ -1,30 +1,148 @@
+#include <algorithm> // for std::min()
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
 
+#include "Checkpoint.hpp"
 #include "ParticleFieldCircular.hpp"
 #include "ParticleSim.hpp"
+#include "SimConfig.hpp"
+#include "SimWorker.hpp"
 #include "config.h"
 #include "p_sim_error.h"
 
 using namespace std;
 
-int main()
+/**
+ * Static helper: applies a key press to the frame pacing (+/- double/halve
+ * the timesteps per frame, F toggles fast forward).
+ */
+static void pace_key(sf::Keyboard::Key key, sf::RenderWindow *window,
+                     const SimConfig &config, uint32_t *steps_per_frame,
+                     bool *fast_forward)
 {
-  sf::RenderWindow window(sf::VideoMode({WINDOW_SIZE_X, WINDOW_SIZE_Y}),
-                          "SFML Application");
-  window.setFramerateLimit(FRAMERATE);
+  switch (key)
+  {
+  case sf::Keyboard::Key::Add:
+  case sf::Keyboard::Key::Equal:
+    *steps_per_frame =
+        std::min<uint32_t>(*steps_per_frame * 2, STEPS_PER_FRAME_MAX);
+    break;
+  case sf::Keyboard::Key::Subtract:
+  case sf::Keyboard::Key::Hyphen:
+    *steps_per_frame = std::max<uint32_t>(*steps_per_frame / 2, 1);
+    break;
+  case sf::Keyboard::Key::F:
+    *fast_forward = !*fast_forward;
+    window->setFramerateLimit(*fast_forward ? 0 : config.framerate);
+    break;
+  default:
+    return;
+  }
+  printf("%u timesteps per frame%s\n", *steps_per_frame,
+         *fast_forward ? ", fast forward" : "");
+}
+
+/**
+ * --restore starts from a checkpoint instead of new particles, --checkpoint
+ * saves one when the window is closed. --trajectory records the particles to
+ * a compressed trajectory file (see TrajectoryWriter).
+ *
+ * Each frame shows the sim `steps_per_frame` timesteps further, at most
+ * `framerate` frames per second unless `fast_forward` is set. In the window,
+ * + and - double and halve the timesteps per frame, and F toggles fast
+ * forward.
+ *
+ * usage: run [--config FILE] [--key=value ..] [--restore FILE]
+ *            [--checkpoint FILE] [--trajectory FILE] [--print-config]
+ */
+int main(int argc, char **argv)
+{
+  SimConfig config;
+  vector<char *> rest;
+  bool print_config = false;
+  const char *restore_path = NULL;
+  const char *checkpoint_path = NULL;
+  const char *trajectory_path = NULL;
+  if (ERR_OK != config.parse_args(argc, argv, &rest))
+    return 1;
+  for (size_t i = 0; i < rest.size(); i++)
+  {
+    const char *arg = rest[i];
+    bool has_value = i + 1 < rest.size();
+    if (!strcmp(arg, "--print-config"))
+      print_config = true;
+    else if (!strcmp(arg, "--restore") && has_value)
+      restore_path = rest[++i];
+    else if (!strcmp(arg, "--checkpoint") && has_value)
+      checkpoint_path = rest[++i];
+    else if (!strcmp(arg, "--trajectory") && has_value)
+      trajectory_path = rest[++i];
+    else
+    {
+      fprintf(stderr, "unknown argument: %s\n", arg);
+      return 1;
+    }
+  }
+  if (restore_path && ERR_OK != Checkpoint::apply_to_config(restore_path,
+                                                            &config))
+  {
+    fprintf(stderr, "%s: cannot read checkpoint\n", restore_path);
+    return 1;
+  }
+  if (print_config)
+  {
+    config.print(stdout);
+    return 0;
+  }
+  if (ERR_OK != config.validate())
+    return 1;
+
+  sf::RenderWindow window(
+      sf::VideoMode({config.window_size_x, config.window_size_y}),
+      "SFML Application");
+  uint32_t steps_per_frame = config.steps_per_frame;
+  bool fast_forward = config.fast_forward;
+  window.setFramerateLimit(fast_forward ? 0 : config.framerate);
   window.setPosition(sf::Vector2i(25, 55));
-  ParticleSim sim = ParticleSim(PARTICLE_QUANTITY);
-  ParticleFieldCircular field = ParticleFieldCircular(
-      sf::Vector2f(PARTICLE_FIELD_CENTER_X, PARTICLE_FIELD_CENTER_Y),
-      PARTICLE_FIELD_RADIUS, sf::Color::White);
+  ParticleSim sim = ParticleSim(config);
+  ParticleFieldCircular field =
+      ParticleFieldCircular(config, sf::Color::White);
   sim.assign_field((ParticleField *)&field);
   printf("Hello world\n");
-  if (ERR_OK != sim.begin())
+  if (restore_path)
+  {
+    if (ERR_OK != sim.restore(restore_path))
+    {
+      printf("Failure restoring sim.\n");
+      return 1;
+    }
+  }
+  else if (ERR_OK != sim.begin())
   {
     printf("Failure beginning sim.\n");
     return 1;
   }
+  TrajectoryWriter trajectory = TrajectoryWriter(config);
+  if (trajectory_path)
+  {
+    if (ERR_OK != trajectory.open(trajectory_path, config.n_particles))
+    {
+      printf("Failure opening trajectory %s\n", trajectory_path);
+      return 1;
+    }
+    sim.assign_trajectory(&trajectory);
+  }
+  // Pipelined: the next timesteps are computed on a worker thread while each
+  // frame draws the last published snapshot
+  SimWorker worker = SimWorker(&sim);
+  if (ERR_OK != worker.start())
+  {
+    printf("Failure starting sim worker.\n");
+    return 1;
+  }
   printf("Sim has begun\n");
   uint32_t timestep = 0;
   const uint32_t TIMESTEP_EXIT = UINT32_MAX;
@@ -38,24 +156,46 @@ int main()
     {
       if (event->is<sf::Event::Closed>())
         window.close();
+      else if (const auto *key = event->getIf<sf::Event::KeyPressed>())
+        pace_key(key->code, &window, config, &steps_per_frame,
+                 &fast_forward);
     }
+    p_sim_error_t updated = worker.request(steps_per_frame);
     window.clear();
-    if (ERR_OK != sim.update())
+    p_sim_error_t rendered = sim.render(&window);
+    if (ERR_OK == rendered)
+      window.display();
+    if (ERR_OK == updated)
+      updated = worker.wait();
+    if (ERR_OK != updated)
     {
 #ifdef DEBUG
       printf("Updating failure\n");
 #endif
       return 1;
     }
-    if (ERR_OK != sim.render(&window))
+    if (ERR_OK != rendered)
     {
 #ifdef DEBUG
       printf("Rendering failure\n");
 #endif
       return 1;
     }
-    window.display();
+    sim.publish();
     if (timestep - 1 == TIMESTEP_EXIT)
       break;
   }
+  worker.stop();
+  if (ERR_OK != trajectory.close())
+  {
+    printf("Failure writing trajectory %s\n", trajectory_path);
+    return 1;
+  }
+  if (trajectory_path)
+    trajectory.print_stats(stdout);
+  if (checkpoint_path && ERR_OK != sim.save_checkpoint(checkpoint_path))
+  {
+    printf("Failure saving checkpoint to %s\n", checkpoint_path);
+    return 1;
+  }
 }
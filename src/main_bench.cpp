@@ -0,0 +1,310 @@
+#include <chrono>
+#include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "CollisionKernel.hpp"
+#include "ParticleFieldCircular.hpp"
+#include "ParticleSim.hpp"
+#include "SimConfig.hpp"
+#include "config.h"
+#include "p_sim_error.h"
+
+#ifdef USE_OPENMP
+  #include <omp.h>
+  #define BENCH_BUILD "openmp"
+#else
+  #define BENCH_BUILD "serial"
+#endif
+
+using namespace std;
+
+/**
+ * @brief A benchmark scenario. Particle radii are derived from the packing
+ * fraction and the particle count, so a scenario keeps the same density (and
+ * field size) at every particle count.
+ */
+typedef struct
+{
+  const char *name;
+  float packing;    // fraction of the field area covered by particles
+  float size_ratio; // radius_max / radius_min (1 = monodisperse)
+  float v0_scale;   // max initial velocity, in units of the config's v0_max
+} bench_scenario_t;
+
+static const bench_scenario_t SCENARIOS[] = {
+    {"dilute", 0.02f, 1.0f, 1.0f},
+    {"dense", 0.35f, 1.0f, 1.0f},
+    {"polydisperse", 0.15f, 4.0f, 1.0f},
+    {"fast", 0.10f, 1.0f, 4.0f},
+};
+#define N_SCENARIOS (sizeof(SCENARIOS) / sizeof(SCENARIOS[0]))
+
+typedef struct
+{
+  const bench_scenario_t *scenario;
+  uint32_t n_particles;
+  uint32_t n_threads;
+  queue_kind_t queue;
+  uint32_t n_steps;
+  uint32_t seed;
+  float radius_min;
+  float radius_max;
+  float v0_max;
+  double ms_per_update;
+  sim_stats_t stats;
+} bench_result_t;
+
+/**
+ * Static helper: parses a comma separated list of unsigned integers.
+ */
+static vector<uint32_t> parse_list(const char *arg)
+{
+  vector<uint32_t> values;
+  const char *s = arg;
+  while (*s)
+  {
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s)
+      break;
+    values.push_back((uint32_t)v);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return values;
+}
+
+/**
+ * Static helper: runs one scenario / particle count / thread count point, on
+ * top of the base config (field, restitution, ...).
+ */
+static p_sim_error_t run_point(const SimConfig *base, bench_result_t *r)
+{
+  const bench_scenario_t *sc = r->scenario;
+  SimConfig config = *base;
+  // Uniform radii in [a, k*a] have a mean squared radius of a^2(1+k+k^2)/3
+  float k = sc->size_ratio;
+  float field_area = config.field_radius * config.field_radius;
+  r->radius_min = std::sqrt(3.0f * sc->packing * field_area /
+                            (r->n_particles * (1.0f + k + k * k)));
+  r->radius_max = k * r->radius_min;
+  r->v0_max = sc->v0_scale * base->v0_max;
+  config.n_particles = r->n_particles;
+  config.radius_min = r->radius_min;
+  config.radius_max = r->radius_max;
+  config.v0_max = r->v0_max;
+  config.seed = r->seed;
+  config.calendar_queue = QUEUE_CALENDAR == r->queue;
+  if (ERR_OK != config.validate())
+    return ERR_INVALID_STATE;
+
+#ifdef USE_OPENMP
+  omp_set_num_threads(r->n_threads);
+#endif
+  ParticleSim sim = ParticleSim(config);
+  ParticleFieldCircular field =
+      ParticleFieldCircular(config, sf::Color::White);
+  sim.assign_field((ParticleField *)&field);
+  if (ERR_OK != sim.begin())
+    return ERR_FAIL;
+
+  double total_ms = 0.0;
+  for (uint32_t i = 0; i < r->n_steps; i++)
+  {
+    auto t_start = chrono::steady_clock::now();
+    p_sim_error_t res = sim.update();
+    auto t_end = chrono::steady_clock::now();
+    if (ERR_OK != res)
+      return res;
+    total_ms += chrono::duration<double, milli>(t_end - t_start).count();
+  }
+  r->ms_per_update = total_ms / r->n_steps;
+  r->stats = sim.get_stats();
+  return ERR_OK;
+}
+
+static void print_result(const bench_result_t *r, bool json, bool first)
+{
+  const sim_counters_t &c = r->stats.counters;
+  const sim_phase_times_t &t = r->stats.time;
+  double per_step = 1e3 / r->n_steps;
+  if (json)
+  {
+    printf("%s  {\"build\": \"%s\", \"kernel\": \"%s\", \"scenario\": \"%s\", "
+           "\"particles\": %u, "
+           "\"threads\": %u, \"steps\": %u, \"seed\": %u, "
+           "\"radius_min\": %.4f, \"radius_max\": %.4f, \"v0_max\": %.4f, "
+           "\"ms_per_update\": %.4f, \"events_pushed\": %lu, "
+           "\"events_popped\": %lu, \"events_stale\": %lu, "
+           "\"pair_tests\": %lu, \"collisions\": %lu, \"windows\": %lu, "
+           "\"rollbacks\": %lu, \"edge_tests\": %lu, "
+           "\"redetections\": %lu, \"queue_depth_max\": %lu, "
+           "\"ms_reset\": %.4f, \"ms_detection\": %.4f, "
+           "\"ms_events\": %.4f, \"ms_flight\": %.4f, \"queue\": \"%s\", "
+           "\"neighbor_builds\": %lu}",
+           first ? "" : ",\n", BENCH_BUILD,
+           CollisionKernel::level_name(CollisionKernel::level()),
+           r->scenario->name, r->n_particles,
+           r->n_threads, r->n_steps, r->seed, r->radius_min, r->radius_max,
+           r->v0_max, r->ms_per_update,
+           (unsigned long)c.events_pushed, (unsigned long)c.events_popped,
+           (unsigned long)c.events_stale, (unsigned long)c.pair_tests,
+           (unsigned long)c.collisions, (unsigned long)c.windows,
+           (unsigned long)c.rollbacks, (unsigned long)c.edge_tests,
+           (unsigned long)c.redetections, (unsigned long)c.queue_depth_max,
+           t.reset * per_step, t.detection * per_step, t.events * per_step,
+           t.flight * per_step, CollisionQueue::kind_name(r->queue),
+           (unsigned long)c.neighbor_builds);
+  }
+  else
+  {
+    printf("%s,%s,%s,%u,%u,%u,%u,%.4f,%.4f,%.4f,%.4f,%lu,%lu,%lu,%lu,%lu,%lu,"
+           "%lu,%lu,%lu,%lu,%.4f,%.4f,%.4f,%.4f,%s,%lu\n",
+           BENCH_BUILD, CollisionKernel::level_name(CollisionKernel::level()),
+           r->scenario->name, r->n_particles, r->n_threads,
+           r->n_steps, r->seed, r->radius_min, r->radius_max,
+           r->v0_max, r->ms_per_update,
+           (unsigned long)c.events_pushed, (unsigned long)c.events_popped,
+           (unsigned long)c.events_stale, (unsigned long)c.pair_tests,
+           (unsigned long)c.collisions, (unsigned long)c.windows,
+           (unsigned long)c.rollbacks, (unsigned long)c.edge_tests,
+           (unsigned long)c.redetections, (unsigned long)c.queue_depth_max,
+           t.reset * per_step, t.detection * per_step, t.events * per_step,
+           t.flight * per_step, CollisionQueue::kind_name(r->queue),
+           (unsigned long)c.neighbor_builds);
+  }
+  fflush(stdout);
+}
+
+/**
+ * Benchmark entry point: runs fixed-seed scenarios over particle counts,
+ * thread counts and event queues (binary heap, calendar queue), timing every
+ * `ParticleSim::update()`, and prints one CSV row (or JSON object) per run.
+ *
+ * Particle count, radii and initial speed come from the scenario; every other
+ * parameter (and `--seed`) from the config, see SimConfig.
+ *
+ * usage: run-bench [--steps N] [--counts N,N,..] [--threads N,N,..]
+ *                  [--scenarios name,name,..] [--queues heap,calendar]
+ *                  [--seed N]
+ *                  [--kernel scalar|sse2|avx2|avx512] [--json]
+ *                  [--config FILE] [--key=value ..]
+ */
+int main(int argc, char **argv)
+{
+  uint32_t n_steps = 10;
+  bool json = false;
+  vector<uint32_t> counts = {1000, 2000, 4000};
+  vector<uint32_t> threads = {1};
+  string scenarios = "";
+  vector<queue_kind_t> queues = {QUEUE_HEAP, QUEUE_CALENDAR};
+  SimConfig config;
+  vector<char *> args;
+  if (ERR_OK != config.parse_args(argc, argv, &args))
+    return 1;
+  size_t n_args = args.size();
+  for (size_t i = 0; i < n_args; i++)
+  {
+    bool has_value = i + 1 < n_args;
+    if (!strcmp(args[i], "--steps") && has_value)
+      n_steps = (uint32_t)strtoul(args[++i], NULL, 10);
+    else if (!strcmp(args[i], "--counts") && has_value)
+      counts = parse_list(args[++i]);
+    else if (!strcmp(args[i], "--threads") && has_value)
+      threads = parse_list(args[++i]);
+    else if (!strcmp(args[i], "--scenarios") && has_value)
+      scenarios = string(",") + args[++i] + ",";
+    else if (!strcmp(args[i], "--queues") && has_value)
+    {
+      string names = string(",") + args[++i] + ",";
+      queues.clear();
+      for (queue_kind_t kind : {QUEUE_HEAP, QUEUE_CALENDAR})
+      {
+        string name = string(",") + CollisionQueue::kind_name(kind) + ",";
+        if (names.find(name) != string::npos)
+          queues.push_back(kind);
+      }
+      if (queues.empty())
+      {
+        fprintf(stderr, "unknown queue: %s\n", args[i]);
+        return 1;
+      }
+    }
+    else if (!strcmp(args[i], "--kernel") && has_value)
+    {
+      const char *name = args[++i];
+      simd_level_t level = SIMD_SCALAR;
+      while (level < SIMD_AVX512 &&
+             strcmp(name, CollisionKernel::level_name(level)))
+        level++;
+      if (strcmp(name, CollisionKernel::level_name(level)) ||
+          ERR_OK != CollisionKernel::set_level(level))
+      {
+        fprintf(stderr, "kernel not supported: %s\n", name);
+        return 1;
+      }
+    }
+    else if (!strcmp(args[i], "--json"))
+      json = true;
+    else
+    {
+      fprintf(stderr, "unknown argument: %s\n", args[i]);
+      return 1;
+    }
+  }
+#ifndef USE_OPENMP
+  threads = {1}; // serial build
+#endif
+  if (n_steps == 0)
+    n_steps = 1;
+
+  if (json)
+    printf("[\n");
+  else
+    printf("build,kernel,scenario,particles,threads,steps,seed,radius_min,"
+           "radius_max,v0_max,ms_per_update,events_pushed,events_popped,"
+           "events_stale,pair_tests,collisions,windows,rollbacks,edge_tests,"
+           "redetections,queue_depth_max,ms_reset,ms_detection,ms_events,"
+           "ms_flight,queue,neighbor_builds\n");
+  bool first = true;
+  for (size_t s = 0; s < N_SCENARIOS; s++)
+  {
+    const bench_scenario_t *sc = &SCENARIOS[s];
+    if (!scenarios.empty() &&
+        scenarios.find(string(",") + sc->name + ",") == string::npos)
+      continue;
+    for (uint32_t n_particles : counts)
+    {
+      for (uint32_t n_threads : threads)
+      {
+        for (queue_kind_t queue : queues)
+        {
+          bench_result_t r = bench_result_t();
+          r.scenario = sc;
+          r.n_particles = n_particles;
+          r.n_threads = n_threads;
+          r.queue = queue;
+          r.n_steps = n_steps;
+          r.seed = config.seed;
+          p_sim_error_t res = run_point(&config, &r);
+          if (ERR_OK != res)
+          {
+            fprintf(stderr, "%s/%u/%u/%s failed (0x%x)\n", sc->name,
+                    n_particles, n_threads, CollisionQueue::kind_name(queue),
+                    res);
+            return 1;
+          }
+          print_result(&r, json, first);
+          first = false;
+        }
+      }
+    }
+  }
+  if (json)
+    printf("\n]\n");
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Checkpoint.hpp"
+#include "ParticleFieldCircular.hpp"
+#include "ParticleSim.hpp"
+#include "SimConfig.hpp"
+#include "config.h"
+#include "p_sim_error.h"
+
+using namespace std;
+
+#define HEADLESS_DEFAULT_STEPS 1000
+
+/**
+ * Headless entry point: no window, no frame cap. Advances the sim a fixed
+ * number of timesteps as fast as possible and reports the throughput.
+ *
+ * --restore starts from a checkpoint instead of new particles (its particle
+ * count and field replace the config's). --checkpoint saves one when done,
+ * and also every N timesteps with --checkpoint-every. --trajectory records
+ * the particles to a compressed trajectory file (see TrajectoryWriter).
+ *
+ * usage: run-headless [timesteps] [particles] [--config FILE] [--key=value ..]
+ *                     [--restore FILE] [--checkpoint FILE]
+ *                     [--checkpoint-every N] [--trajectory FILE]
+ *                     [--print-config]
+ */
+int main(int argc, char **argv)
+{
+  SimConfig config;
+  vector<char *> rest;
+  vector<char *> positional;
+  bool print_config = false;
+  const char *restore_path = NULL;
+  const char *checkpoint_path = NULL;
+  uint32_t checkpoint_every = 0;
+  const char *trajectory_path = NULL;
+  if (ERR_OK != config.parse_args(argc, argv, &rest))
+    return 1;
+  for (size_t i = 0; i < rest.size(); i++)
+  {
+    const char *arg = rest[i];
+    bool has_value = i + 1 < rest.size();
+    if (!strcmp(arg, "--print-config"))
+      print_config = true;
+    else if (!strcmp(arg, "--restore") && has_value)
+      restore_path = rest[++i];
+    else if (!strcmp(arg, "--checkpoint") && has_value)
+      checkpoint_path = rest[++i];
+    else if (!strcmp(arg, "--checkpoint-every") && has_value)
+      checkpoint_every = (uint32_t)strtoul(rest[++i], NULL, 10);
+    else if (!strcmp(arg, "--trajectory") && has_value)
+      trajectory_path = rest[++i];
+    else if (!strncmp(arg, "--", 2) || positional.size() == 2)
+    {
+      fprintf(stderr, "unknown argument: %s\n", arg);
+      return 1;
+    }
+    else
+      positional.push_back(rest[i]);
+  }
+  uint32_t n_steps = HEADLESS_DEFAULT_STEPS;
+  if (positional.size() > 0)
+    n_steps = (uint32_t)strtoul(positional[0], NULL, 10);
+  if (positional.size() > 1)
+    config.n_particles = (uint32_t)strtoul(positional[1], NULL, 10);
+  if (restore_path && ERR_OK != Checkpoint::apply_to_config(restore_path,
+                                                            &config))
+  {
+    fprintf(stderr, "%s: cannot read checkpoint\n", restore_path);
+    return 1;
+  }
+  if (print_config)
+  {
+    config.print(stdout);
+    return 0;
+  }
+  if (ERR_OK != config.validate())
+    return 1;
+  uint32_t n_particles = config.n_particles;
+
+  ParticleSim sim = ParticleSim(config);
+  ParticleFieldCircular field =
+      ParticleFieldCircular(config, sf::Color::White);
+  sim.assign_field((ParticleField *)&field);
+  if (restore_path)
+  {
+    auto t_load = chrono::steady_clock::now();
+    p_sim_error_t res = sim.restore(restore_path);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                                t_load)
+                    .count();
+    if (ERR_OK != res)
+    {
+      printf("Failure restoring sim (0x%x).\n", res);
+      return 1;
+    }
+    printf("Restored timestep %lu from %s in %0.3f ms\n",
+           (unsigned long)sim.get_timestep(), restore_path, ms);
+  }
+  else if (ERR_OK != sim.begin())
+  {
+    printf("Failure beginning sim.\n");
+    return 1;
+  }
+  TrajectoryWriter trajectory = TrajectoryWriter(config);
+  if (trajectory_path)
+  {
+    if (ERR_OK != trajectory.open(trajectory_path, n_particles))
+    {
+      printf("Failure opening trajectory %s\n", trajectory_path);
+      return 1;
+    }
+    sim.assign_trajectory(&trajectory);
+  }
+  printf("Running %u timesteps with %u particles\n", n_steps, n_particles);
+
+  auto t_start = chrono::steady_clock::now();
+  p_sim_error_t res = ERR_OK;
+  uint32_t done = 0;
+  while (ERR_OK == res && done < n_steps)
+  {
+    uint32_t chunk = n_steps - done;
+    if (checkpoint_every > 0 && chunk > checkpoint_every)
+      chunk = checkpoint_every;
+    res = sim.step(chunk);
+    done += chunk;
+    if (ERR_OK == res && checkpoint_path && done < n_steps)
+      res = sim.save_checkpoint(checkpoint_path);
+  }
+  auto t_end = chrono::steady_clock::now();
+  if (ERR_OK != res)
+  {
+    printf("Updating failure (0x%x)\n", res);
+    return 1;
+  }
+  if (ERR_OK != trajectory.close())
+  {
+    printf("Failure writing trajectory %s\n", trajectory_path);
+    return 1;
+  }
+  if (checkpoint_path && ERR_OK != sim.save_checkpoint(checkpoint_path))
+  {
+    printf("Failure saving checkpoint to %s\n", checkpoint_path);
+    return 1;
+  }
+
+  double seconds = chrono::duration<double>(t_end - t_start).count();
+  uint64_t collisions = sim.get_counters().collisions;
+  printf("elapsed:        %0.3f s\n", seconds);
+  printf("steps/sec:      %0.2f\n", n_steps / seconds);
+  printf("collisions:     %lu\n", (unsigned long)collisions);
+  printf("collisions/sec: %0.2f\n", collisions / seconds);
+  sim.print_stats(stdout);
+  if (trajectory_path)
+    trajectory.print_stats(stdout);
+  return 0;
+}
@@ -11,8 +11,14 @@ typedef int32_t p_sim_error_t;
 #define ERR_NOT_IMPLEMENTED 0xFFF
 #define ERR_NO_MEMORY 0x103
 #define ERR_NO_DATA 0x104
+#define ERR_IO 0x105
+#define ERR_FORMAT 0x106
+#define ERR_NO_ROOM 0x107
 #define ERR_COLLISION_CHECK_FAIL 0x201
 #define ERR_COLLISION_FAIL 0x202
+#define ERR_CONFIG_KEY 0x301
+#define ERR_CONFIG_VALUE 0x302
+#define ERR_CONFIG_FILE 0x303
 
 typedef int32_t collision_status_t;
 #define COLLISION_TRUE 1